@@ -0,0 +1,143 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "include/allocator/aligned.h"
+#include "include/allocator/arena.h"
+#include "include/allocator/bump.h"
+#include "include/container/bit_vector.h"
+#include "include/container/tokenizer.h"
+#include "include/memory/interner.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Each allocator family, as a template that takes a type and an alignment,
+// the 32-byte aligned allocator that its bit vectors use, and what it does at
+// the end of a request. std::allocator can't promise 32 bytes, so its bit
+// vectors use Aligned.
+struct UseStd {
+  template <typename T, size_t N>
+  using alloc = std::allocator<T>;
+  typedef Aligned<uint64_t, 32> bits;
+  static void done() { }
+};
+struct UseAligned {
+  template <typename T, size_t N>
+  using alloc = Aligned<T, N>;
+  typedef alloc<uint64_t, 32> bits;
+  static void done() { }
+};
+struct UseMonotonic {
+  template <typename T, size_t N>
+  using alloc = Monotonic<T, N>;
+  typedef alloc<uint64_t, 32> bits;
+  static void done() {
+    Arena::current()->reset();
+  }
+};
+struct UseBump {
+  template <typename T, size_t N>
+  using alloc = Bump<T, N>;
+  typedef alloc<uint64_t, 32> bits;
+  static void done() {
+    Bump<char>::reset();
+  }
+};
+
+// One request: a few short-lived containers, all built with the same family
+template <typename F>
+size_t request(const vector<uint64_t>& keys) {
+  typedef typename F::template alloc<uint64_t, 16> Quads;
+  typedef typename F::template alloc<pair<const uint64_t, uint64_t>, 16> Pairs;
+  typedef unordered_map<uint64_t, uint64_t, hash<uint64_t>, equal_to<uint64_t>, Pairs> Map;
+
+  BasicBitVector<typename F::bits> seen(1024);
+  BasicBitVector<typename F::bits> mask(1024);
+  Interner<uint64_t, unordered_set<uint64_t, hash<uint64_t>, equal_to<uint64_t>, Quads>> in;
+  Tokenizer<uint64_t, uint64_t, Map, Map> tok;
+  vector<uint64_t, Quads> order;
+
+  for (auto k : keys) {
+    seen.get_bit(k % 1024) = true;
+    mask.get_bit((k / 1024) % 1024) = true;
+    in.intern(k);
+    tok.tokenize(k % 97);
+    order.push_back(k);
+  }
+  // A bulk operator, which uses the aligned kernels
+  seen &= mask;
+  return seen.num_set_bits() + in.size() + tok.size() + order.size();
+}
+
+// Returns the number of nanoseconds per request
+template <typename F>
+double run(const vector<vector<uint64_t>>& reqs, size_t& sum) {
+  const auto start = high_resolution_clock::now();
+  for (const auto& r : reqs) {
+    sum += request<F>(r);
+    F::done();
+  }
+  return duration<double>(high_resolution_clock::now() - start).count() * 1e9 / reqs.size();
+}
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+
+  // Requests of between 1 and 256 keys
+  mt19937_64 gen(0);
+  vector<vector<uint64_t>> reqs(n);
+  for (auto& r : reqs) {
+    r.resize(1 + gen() % 256);
+    for (auto& k : r) {
+      k = gen() % 4096;
+    }
+  }
+
+  Arena arena;
+  Arena::Scope scope(arena);
+
+  size_t s1 = 0;
+  size_t s2 = 0;
+  size_t s3 = 0;
+  size_t s4 = 0;
+  const auto t1 = run<UseStd>(reqs, s1);
+  const auto t2 = run<UseAligned>(reqs, s2);
+  const auto t3 = run<UseMonotonic>(reqs, s3);
+  const auto t4 = run<UseBump>(reqs, s4);
+
+  cout << n << " requests (ns per request)" << endl;
+  cout << fixed << setprecision(1);
+  cout << setw(16) << "std::allocator" << setw(12) << t1 << endl;
+  cout << setw(16) << "Aligned" << setw(12) << t2 << endl;
+  cout << setw(16) << "Monotonic" << setw(12) << t3;
+  cout << (s3 == s1 ? "" : "   MISMATCH!") << endl;
+  cout << setw(16) << "Bump" << setw(12) << t4;
+  cout << (s4 == s1 ? "" : "   MISMATCH!") << endl;
+  cout << "Arena chunks hold " << arena.capacity() << " bytes" << endl;
+
+  return 0;
+}
@@ -0,0 +1,87 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "include/allocator/huge_aligned.h"
+#include "include/container/bit_vector.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Returns the number of KiB of this process that sit on transparent huge pages
+size_t anon_huge_kb() {
+  ifstream ifs("/proc/self/smaps_rollup");
+  string s;
+  while (ifs >> s) {
+    if (s == "AnonHugePages:") {
+      size_t kb = 0;
+      ifs >> kb;
+      return kb;
+    }
+  }
+  return 0;
+}
+
+// Fills a bit vector of n bits, reads it at random, and prints millions of
+// lookups per second and how much of it sits on huge pages
+template <typename A>
+void run(const char* name, size_t n, size_t lookups) {
+  const auto before = anon_huge_kb();
+  BasicBitVector<A> bv(n);
+  for (auto i = bv.fixed_quad_begin(), ie = bv.fixed_quad_end(); i != ie; ++i) {
+    *i = 0x0123456789abcdefull * (uint64_t)(i - bv.fixed_quad_begin());
+  }
+  const auto huge = anon_huge_kb() - before;
+
+  // xorshift, so that the indices don't need memory of their own
+  uint64_t x = 88172645463325252ull;
+  size_t sum = 0;
+  const auto start = high_resolution_clock::now();
+  for (size_t i = 0; i < lookups; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    sum += bv.get_bit(x % n);
+  }
+  const auto secs = duration<double>(high_resolution_clock::now() - start).count();
+
+  cout << setw(24) << name << setw(12) << lookups / secs / 1e6;
+  cout << setw(14) << huge / 1024 << "   (" << sum << ")" << endl;
+}
+
+int main(int argc, char** argv) {
+  const size_t mib = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1024;
+  const size_t lookups = argc > 2 ? strtoull(argv[2], nullptr, 10) : 50000000;
+  const auto n = mib * 8 * 1024 * 1024;
+
+  cout << "Random get_bit on " << mib << " MiB" << endl;
+  cout << setw(24) << "allocator" << setw(12) << "Mlookups/s" << setw(14) << "huge (MiB)";
+  cout << endl;
+  cout << fixed << setprecision(2);
+  run<Aligned<uint64_t, 32>>("Aligned", n, lookups);
+  run<HugeAligned<uint64_t, 32, HugePages::NONE>>("HugeAligned none", n, lookups);
+  run<HugeAligned<uint64_t, 32, HugePages::TRANSPARENT>>("HugeAligned transparent", n, lookups);
+  run<HugeAligned<uint64_t, 32, HugePages::EXPLICIT>>("HugeAligned explicit", n, lookups);
+  run<HugeAligned<uint64_t, 32, HugePages::TRANSPARENT, NumaPolicy::INTERLEAVE>>(
+    "HugeAligned interleave", n, lookups);
+
+  return 0;
+}
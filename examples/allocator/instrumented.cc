@@ -0,0 +1,121 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "include/allocator/aligned.h"
+#include "include/allocator/instrumented.h"
+#include "include/container/bit_vector.h"
+#include "include/container/tokenizer.h"
+#include "include/memory/interner.h"
+#include "include/serialize/text_writer.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// One tag for each kind of container
+struct Names {
+  static const char* name() {
+    return "names";
+  }
+};
+struct Tokens {
+  static const char* name() {
+    return "tokens";
+  }
+};
+struct Bits {
+  static const char* name() {
+    return "bits";
+  }
+};
+
+template <typename Tag, typename T>
+using Counted = Instrumented<allocator<T>, Tag>;
+
+typedef Interner<string, unordered_set<string, hash<string>, equal_to<string>,
+                 Counted<Names, string>>> NameInterner;
+typedef Tokenizer<uint64_t, uint64_t,
+                  unordered_map<uint64_t, uint64_t, hash<uint64_t>, equal_to<uint64_t>,
+                                Counted<Tokens, pair<const uint64_t, uint64_t>>>,
+                  unordered_map<uint64_t, uint64_t, hash<uint64_t>, equal_to<uint64_t>,
+                                Counted<Tokens, pair<const uint64_t, uint64_t>>>> TokenTokenizer;
+typedef BasicBitVector<Instrumented<Aligned<uint64_t, 32>, Bits>> CountedBitVector;
+
+// A unit of work that uses all three
+size_t work(size_t seed, size_t n) {
+  NameInterner names;
+  TokenTokenizer tok;
+  vector<CountedBitVector> bits;
+  for (size_t i = 0; i < n; ++i) {
+    names.intern("name_" + to_string((seed + i) % 500));
+    tok.tokenize((seed * i) % 1000);
+    if (i % 100 == 0) {
+      bits.emplace_back(64 * (i + 1));
+    }
+  }
+  return names.size() + tok.size() + bits.size();
+}
+
+int main() {
+  // Four threads, each counting into its own counters
+  const auto start = high_resolution_clock::now();
+  vector<thread> threads;
+  size_t sums[4] = {0, 0, 0, 0};
+  for (size_t t = 0; t < 4; ++t) {
+    threads.emplace_back([t, &sums] {
+      for (size_t i = 0; i < 50; ++i) {
+        sums[t] += work(t * 50 + i, 2000);
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  const auto secs = duration<double>(high_resolution_clock::now() - start).count();
+
+  cout << "Ran in " << fixed << setprecision(3) << secs << " s" << endl;
+  cout << endl;
+
+  // The report, as text...
+  cout << "{ tag allocs frees bytes live peak { sizes } }" << endl;
+  TextWriter<vector<AllocStats>>()(cout, AllocSite::report());
+  cout << endl << endl;
+
+  // ...and as a table
+  cout << setw(8) << "tag" << setw(12) << "allocs" << setw(14) << "bytes";
+  cout << setw(12) << "peak" << "   most common size" << endl;
+  for (const auto& s : AllocSite::report()) {
+    size_t b = 0;
+    for (size_t i = 0; i < s.sizes.size(); ++i) {
+      b = s.sizes[i] > s.sizes[b] ? i : b;
+    }
+    cout << setw(8) << s.tag << setw(12) << s.allocs << setw(14) << s.bytes;
+    cout << setw(12) << s.peak << "   " << (b == 0 ? 1 : (1ull << (b - 1)) + 1) << " to ";
+    cout << (1ull << b) << " bytes" << endl;
+  }
+
+  return 0;
+}
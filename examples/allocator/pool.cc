@@ -0,0 +1,140 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "include/allocator/aligned.h"
+#include "include/allocator/pool.h"
+#include "include/container/tokenizer.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// The containers that one thread churns on, all built with allocator family A
+template <template <typename, size_t> class A>
+struct Work {
+  typedef pair<const uint64_t, uint64_t> Pair;
+  typedef map<uint64_t, uint64_t, less<uint64_t>, A<Pair, 16>> Map;
+  typedef unordered_set<uint64_t, hash<uint64_t>, equal_to<uint64_t>, A<uint64_t, 16>> Set;
+  typedef unordered_map<uint64_t, uint64_t, hash<uint64_t>, equal_to<uint64_t>, A<Pair, 16>> HMap;
+
+  Map m;
+  Set s;
+  Tokenizer<uint64_t, uint64_t, HMap, Map> tok;
+
+  // Inserts a key that isn't there yet, or erases it if it is
+  void churn(uint64_t k) {
+    if (!m.erase(k)) {
+      m[k] = k;
+    }
+    if (!s.erase(k)) {
+      s.insert(k);
+    }
+    tok.tokenize(k % 1024);
+  }
+};
+
+template <typename T, size_t N>
+using Std = std::allocator<T>;
+
+// Returns this process' resident set size in MiB
+double rss() {
+  ifstream ifs("/proc/self/statm");
+  size_t pages = 0;
+  ifs >> pages >> pages;
+  return pages * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+// Runs rounds of churn on t threads. Each round starts new threads, and each
+// thread works on the containers of a different thread from the round
+// before, so most nodes are freed on a thread other than the one that made
+// them. Prints millions of operations per second and RSS.
+template <template <typename, size_t> class A>
+void run(const char* name, size_t t, size_t ops) {
+  const size_t rounds = 8;
+  vector<Work<A>> work(t);
+
+  const auto start = high_resolution_clock::now();
+  for (size_t r = 0; r < rounds; ++r) {
+    vector<thread> threads;
+    for (size_t i = 0; i < t; ++i) {
+      threads.emplace_back([&work, r, i, t, ops] {
+        auto& w = work[(i + r) % t];
+        mt19937_64 gen(r * t + i);
+        for (size_t j = 0; j < ops; ++j) {
+          w.churn(gen() % 8192);
+        }
+      });
+    }
+    for (auto& th : threads) {
+      th.join();
+    }
+  }
+  const auto secs = duration<double>(high_resolution_clock::now() - start).count();
+
+  cout << setw(16) << name << setw(12) << rounds * t * ops / secs / 1e6;
+  cout << setw(12) << rss() << endl;
+}
+
+// Runs a benchmark in a child process, so that each one starts from the same
+// RSS
+template <typename F>
+void isolate(F f) {
+  cout.flush();
+  const auto pid = fork();
+  if (pid == 0) {
+    f();
+    cout.flush();
+    _exit(0);
+  }
+  waitpid(pid, nullptr, 0);
+}
+
+int main(int argc, char** argv) {
+  const size_t ops = argc > 1 ? strtoull(argv[1], nullptr, 10) : 50000;
+  const size_t max_threads = argc > 2 ? strtoull(argv[2], nullptr, 10) : 8;
+
+  cout << fixed << setprecision(2);
+  for (size_t t = 1; t <= max_threads; t *= 2) {
+    cout << t << " thread(s), " << ops << " operations each per round" << endl;
+    cout << setw(16) << "allocator" << setw(12) << "Mops/s" << setw(12) << "RSS (MiB)" << endl;
+    isolate([=] { run<Std>("std::allocator", t, ops); });
+    isolate([=] { run<Aligned>("Aligned", t, ops); });
+    isolate([=] {
+      run<Pooled>("Pooled", t, ops);
+      cout << setw(16) << "" << "(slabs hold " << SizeClassPool::slab_bytes() / 1024;
+      cout << " KiB)" << endl;
+    });
+    cout << endl;
+  }
+
+  return 0;
+}
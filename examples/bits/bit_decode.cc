@@ -0,0 +1,166 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "include/bits/bit_decode.h"
+#include "include/container/bit_vector.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Returns a bit vector in which every bit is set with probability d
+BitVector random_bits(size_t n, double d, mt19937_64& gen) {
+  BitVector bv(n);
+  bernoulli_distribution coin(d);
+  for (size_t i = 0; i < n; ++i) {
+    bv.get_bit(i) = coin(gen);
+  }
+  return bv;
+}
+
+// Returns the number of seconds it takes to run f
+template <typename F>
+double time(F f) {
+  const auto start = high_resolution_clock::now();
+  f();
+  return duration<double>(high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+  // The kernels work on whole quads, so the size is rounded down to one
+  const size_t n = (argc > 1 ? strtoull(argv[1], nullptr, 10) : ((size_t) 1 << 26)) / 64 * 64;
+
+  BitVector small(300);
+  small.get_bit(3) = true;
+  small.get_bit(64) = true;
+  small.get_bit(299) = true;
+  cout << "Set bits: ";
+  for (auto b = small.set_bit_index_batch_begin(), be = small.set_bit_index_batch_end(); b != be;
+       ++b) {
+    for (auto i : *b) {
+      cout << i << " ";
+    }
+  }
+  cout << endl;
+  cout << "Host supports avx2: " << (BitDecode::has_avx2() ? "yes" : "no") << endl;
+  cout << "Host supports avx512: " << (BitDecode::has_avx512() ? "yes" : "no") << endl;
+  cout << endl;
+
+  cout << "Decoding " << n << " bits" << endl;
+  cout << setw(10) << "density" << setw(12) << "iterator" << setw(12) << "batch" <<
+       setw(12) << "scalar" << setw(12) << "avx2" << setw(12) << "avx512" << "   (M indices/s)" <<
+       endl;
+
+  mt19937_64 gen(0);
+  for (auto d : {0.001, 0.01, 0.1, 0.25, 0.5, 0.9}) {
+    const auto bv = random_bits(n, d, gen);
+    const auto p = (const uint64_t*) bv.data();
+    const auto k = bv.num_set_bits();
+    vector<uint32_t> out(k + BitDecode::SLACK);
+    bool ok = true;
+
+    size_t sum = 0;
+    const auto t_itr = time([&] {
+      for (auto i = bv.set_bit_index_begin(), ie = bv.set_bit_index_end(); i != ie; ++i) {
+        sum += *i;
+      }
+    });
+    size_t batch_sum = 0;
+    const auto t_batch = time([&] {
+      for (auto b = bv.set_bit_index_batch_begin(), be = bv.set_bit_index_batch_end(); b != be; ++b) {
+        for (auto i : *b) {
+          batch_sum += i;
+        }
+      }
+    });
+    ok &= sum == batch_sum;
+
+    cout << setw(10) << defaultfloat << setprecision(3) << (100 * d);
+    cout << setw(12) << fixed << setprecision(1) << (k / t_itr / 1e6);
+    cout << setw(12) << (k / t_batch / 1e6);
+
+    for (auto kernel : {BitDecode::scalar, BitDecode::avx2, BitDecode::avx512}) {
+      if ((kernel == BitDecode::avx2 && !BitDecode::has_avx2()) ||
+          (kernel == BitDecode::avx512 && !BitDecode::has_avx512())) {
+        cout << setw(12) << "-";
+        continue;
+      }
+      size_t res = 0;
+      const auto t = time([&] {
+        res = kernel(p, n / 64, 0, out.data());
+      });
+      size_t kernel_sum = 0;
+      for (size_t i = 0; i < res; ++i) {
+        kernel_sum += out[i];
+      }
+      ok &= res == k && kernel_sum == sum;
+      cout << setw(12) << (k / t / 1e6);
+    }
+
+    ok &= bv.decode_set_bits(out.data()) == k;
+    cout << defaultfloat << (ok ? "" : "   MISMATCH!") << endl;
+  }
+  cout << endl;
+
+  cout << "Finding the nonzero lanes of " << n / 8 << " bytes" << endl;
+  cout << setw(10) << "density" << setw(12) << "bytes" << setw(12) << "bytes" << setw(12) <<
+       "quads" << setw(12) << "quads" << "   (M lanes scanned/s)" << endl;
+  cout << setw(10) << "(%)" << setw(12) << "iterator" << setw(12) << "bulk" << setw(12) <<
+       "iterator" << setw(12) << "bulk" << endl;
+
+  for (auto d : {0.0001, 0.001, 0.01, 0.1}) {
+    const auto bv = random_bits(n, d / 8, gen);
+    vector<uint32_t> out(bv.num_fixed_bytes());
+    bool ok = true;
+
+    size_t byte_count = 0;
+    const auto t_byte_itr = time([&] {
+      for (auto i = bv.set_byte_index_begin(), ie = bv.set_byte_index_end(); i != ie; ++i) {
+        ++byte_count;
+      }
+    });
+    size_t res = 0;
+    const auto t_byte_bulk = time([&] {
+      res = bv.decode_set_bytes(out.data());
+    });
+    ok &= res == byte_count && byte_count == bv.num_set_bytes();
+
+    size_t quad_count = 0;
+    const auto t_quad_itr = time([&] {
+      for (auto i = bv.set_quad_index_begin(), ie = bv.set_quad_index_end(); i != ie; ++i) {
+        ++quad_count;
+      }
+    });
+    const auto t_quad_bulk = time([&] {
+      res = bv.decode_set_quads(out.data());
+    });
+    ok &= res == quad_count && quad_count == bv.num_set_quads();
+
+    cout << setw(10) << defaultfloat << setprecision(3) << (100 * d);
+    cout << setw(12) << fixed << setprecision(1) << (bv.num_fixed_bytes() / t_byte_itr / 1e6);
+    cout << setw(12) << (bv.num_fixed_bytes() / t_byte_bulk / 1e6);
+    cout << setw(12) << (bv.num_fixed_quads() / t_quad_itr / 1e6);
+    cout << setw(12) << (bv.num_fixed_quads() / t_quad_bulk / 1e6);
+    cout << defaultfloat << (ok ? "" : "   MISMATCH!") << endl;
+  }
+
+  return 0;
+}
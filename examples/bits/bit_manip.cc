@@ -0,0 +1,126 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "include/bits/bit_manip.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+typedef BitManip<uint64_t> BM;
+
+// Everything that doesn't need pdep or pext can be computed at compile time
+static_assert(BM::ntz(0x80) == 7 && BM::nlz(0x80) == 56, "");
+static_assert(BM::reverse(0x1) == 0x8000000000000000ull, "");
+static_assert(BitManip<uint8_t>::next_permutation(0x0b) == 0x0d, "");
+static_assert(BitManip<uint16_t>::extract_bits(0xabcd, 4, 8) == 0xbc, "");
+
+// Applies f to each word and returns the number of nanoseconds per word; the
+// results are summed into sum so that the calls can't be thrown away
+template <typename F>
+double bench(const vector<uint64_t>& xs, size_t reps, uint64_t& sum, F f) {
+  const auto start = high_resolution_clock::now();
+  for (size_t r = 0; r < reps; ++r) {
+    for (auto x : xs) {
+      sum += f(x);
+    }
+  }
+  return duration<double>(high_resolution_clock::now() - start).count() * 1e9 / (reps * xs.size());
+}
+
+// Compares the bmi2 and portable versions of one of the dispatched operations
+void versus(const char* name, const vector<uint64_t>& xs, size_t reps, BM::deposit_type bmi2,
+            BM::deposit_type scalar) {
+  // Calling through volatile pointers keeps the kernels from being inlined
+  volatile BM::deposit_type vb = bmi2;
+  volatile BM::deposit_type vs = scalar;
+  const auto m = xs.back();
+
+  uint64_t s1 = 0;
+  uint64_t s2 = 0;
+  cout << setw(18) << name << fixed << setprecision(2);
+  cout << setw(10) << bench(xs, reps, s1, [&](uint64_t x) {
+    return vs(x, m);
+  });
+  if (CpuFeatures::has_avx2()) {
+    cout << setw(10) << bench(xs, reps, s2, [&](uint64_t x) {
+      return vb(x, m);
+    });
+  } else {
+    cout << setw(10) << "-";
+    s2 = s1;
+  }
+  cout << defaultfloat << (s1 == s2 ? "" : "   MISMATCH!") << endl;
+}
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4096;
+  const size_t reps = (1 << 24) / n + 1;
+
+  vector<uint64_t> xs(n);
+  mt19937_64 gen(0);
+  for (auto& x : xs) {
+    x = gen() | 0x1;
+  }
+
+  // pdep, pext and select are picked when they're first called, so both
+  // versions can be timed on one host
+  cout << "Dispatched operations (ns per word)" << endl;
+  cout << setw(18) << "op" << setw(10) << "scalar" << setw(10) << "bmi2" << endl;
+  versus("pdep", xs, reps, BM::pdep_bmi2, BM::pdep_scalar);
+  versus("pext", xs, reps, BM::pext_bmi2, BM::pext_scalar);
+  versus("select", xs, reps, [](uint64_t x, uint64_t r) -> uint64_t {
+    return BM::select_bmi2(x, r % BM::pop_count(x));
+  }, [](uint64_t x, uint64_t r) -> uint64_t {
+    return BM::select_scalar(x, r % BM::pop_count(x));
+  });
+  cout << endl;
+
+  // The rest are chosen at compile time; build with ARCH= to time the portable
+  // versions of these instead
+  uint64_t sum = 0;
+  cout << "Inlined operations (ns per word)" << endl;
+  cout << fixed << setprecision(2);
+  cout << setw(18) << "ntz" << setw(10) << bench(xs, reps, sum, [](uint64_t x) {
+    return BM::ntz(x);
+  }) << endl;
+  cout << setw(18) << "nlz" << setw(10) << bench(xs, reps, sum, [](uint64_t x) {
+    return BM::nlz(x);
+  }) << endl;
+  cout << setw(18) << "pop_count" << setw(10) << bench(xs, reps, sum, [](uint64_t x) {
+    return BM::pop_count(x);
+  }) << endl;
+  cout << setw(18) << "parity" << setw(10) << bench(xs, reps, sum, [](uint64_t x) {
+    return BM::parity(x);
+  }) << endl;
+  cout << setw(18) << "reverse" << setw(10) << bench(xs, reps, sum, [](uint64_t x) {
+    return BM::reverse(x);
+  }) << endl;
+  cout << setw(18) << "next_permutation" << setw(10) << bench(xs, reps, sum, [](uint64_t x) {
+    return BM::next_permutation(x);
+  }) << endl;
+  cout << setw(18) << "extract_bits" << setw(10) << bench(xs, reps, sum, [](uint64_t x) {
+    return BM::extract_bits(x, x % 64, 17);
+  }) << endl;
+  cout << defaultfloat << "Checksum: " << sum << endl;
+
+  return 0;
+}
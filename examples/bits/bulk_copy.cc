@@ -0,0 +1,108 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "include/bits/bulk_copy.h"
+#include "include/container/bit_vector.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// A cache-sensitive workload: random reads from a table that fits in cache.
+// Counts completed reads until told to stop.
+void workload(const vector<uint32_t>& table, atomic<bool>& stop, atomic<size_t>& reads) {
+  size_t i = 0;
+  size_t local = 0;
+  while (!stop.load(memory_order_relaxed)) {
+    for (size_t j = 0; j < 1024; ++j) {
+      i = table[i];
+    }
+    local += 1024;
+    reads.store(local, memory_order_relaxed);
+  }
+  // Keep the chase from being optimized away
+  if (i == table.size()) {
+    cout << "";
+  }
+}
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : ((size_t) 1 << 32);
+  const size_t table_bytes = argc > 2 ? strtoull(argv[2], nullptr, 10) : ((size_t) 1 << 21);
+  const size_t reps = 4;
+
+  // A single random cycle through the table, so every read misses if the
+  // table has been evicted
+  vector<uint32_t> table(table_bytes / sizeof(uint32_t));
+  vector<uint32_t> order(table.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  shuffle(order.begin(), order.end(), mt19937_64(0));
+  for (size_t i = 0; i < order.size(); ++i) {
+    table[order[i]] = order[(i + 1) % order.size()];
+  }
+
+  BitVector src(n);
+  BitVector dst(n);
+  src.set();
+
+  cout << "Copying and clearing " << (n / 8 >> 20) << " MiB bit vectors while another thread " <<
+       "reads randomly from a " << (table_bytes >> 10) << " KiB table" << endl;
+  cout << setw(12) << "mode" << setw(14) << "copy (GB/s)" << setw(15) << "reset (GB/s)" <<
+       setw(20) << "reads (M/s)" << endl;
+
+  for (auto mode : {StoreMode::CACHED, StoreMode::STREAMING}) {
+    atomic<bool> stop(false);
+    atomic<size_t> reads(0);
+    thread t(workload, ref(table), ref(stop), ref(reads));
+
+    double copy_secs = 0;
+    double reset_secs = 0;
+    const auto start = high_resolution_clock::now();
+    const auto start_reads = reads.load();
+    for (size_t i = 0; i < reps; ++i) {
+      auto s = high_resolution_clock::now();
+      dst.copy(src, mode);
+      copy_secs += duration<double>(high_resolution_clock::now() - s).count();
+      s = high_resolution_clock::now();
+      dst.reset(mode);
+      reset_secs += duration<double>(high_resolution_clock::now() - s).count();
+    }
+    const auto secs = duration<double>(high_resolution_clock::now() - start).count();
+    const auto total_reads = reads.load() - start_reads;
+    stop = true;
+    t.join();
+
+    cout << setw(12) << (mode == StoreMode::CACHED ? "cached" : "streaming");
+    cout << fixed << setprecision(2);
+    cout << setw(14) << (reps * n / 8 / copy_secs / 1e9);
+    cout << setw(15) << (reps * n / 8 / reset_secs / 1e9);
+    cout << setw(20) << (total_reads / secs / 1e6);
+    cout << defaultfloat << (dst.num_set_bits() == 0 ? "" : "   MISMATCH!") << endl;
+  }
+
+  return 0;
+}
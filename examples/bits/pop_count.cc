@@ -0,0 +1,92 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "include/bits/pop_count.h"
+#include "include/container/bit_vector.h"
+#include "include/system/cpu_features.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Runs k over the first n quads of p until ~32MB have been touched and
+// returns the observed bandwidth in GB/s. Calling through a volatile pointer
+// keeps the compiler from hoisting the kernel out of the loop.
+double bench(PopCount::kernel_type k, const uint64_t* p, size_t n, size_t& res) {
+  const auto reps = max((size_t) 1, ((size_t) 1 << 22) / n);
+  volatile PopCount::kernel_type vk = k;
+
+  const auto start = high_resolution_clock::now();
+  for (size_t i = 0; i < reps; ++i) {
+    res = vk(p, n);
+  }
+  const auto secs = duration<double>(high_resolution_clock::now() - start).count();
+
+  return (8.0 * n * reps) / secs / 1e9;
+}
+
+int main(int argc, char** argv) {
+  // Sizes run from one cache line to 1 GiB unless an upper bound is given
+  const size_t max_bytes = argc > 1 ? strtoull(argv[1], nullptr, 10) : ((size_t) 1 << 30);
+
+  BitVector bv(8 * max_bytes);
+  mt19937_64 gen(0);
+  for (auto i = bv.fixed_quad_begin(), ie = bv.fixed_quad_end(); i != ie; ++i) {
+    *i = gen();
+  }
+
+  cout << "Host supports popcnt: " << (CpuFeatures::has_popcnt() ? "yes" : "no") << endl;
+  cout << "Host supports avx2: " << (PopCount::has_avx2() ? "yes" : "no") << endl;
+  cout << "Host supports avx512: " << (PopCount::has_avx512() ? "yes" : "no") << endl;
+  cout << "Total set bits: " << bv.num_set_bits() << endl;
+  cout << endl;
+
+  cout << setw(12) << "bytes" << setw(12) << "scalar" << setw(12) << "popcnt" << setw(12) <<
+       "avx2" << setw(12) << "avx512" << "   (GB/s)" << endl;
+  for (size_t bytes = 64; bytes <= max_bytes; bytes *= 2) {
+    const auto p = bv.fixed_quad_begin();
+    const auto n = bytes / 8;
+
+    size_t r1 = 0, r2 = 0, r3 = 0, r4 = 0;
+    cout << setw(12) << bytes;
+    cout << setw(12) << fixed << setprecision(2) << bench(PopCount::scalar, p, n, r1);
+    if (CpuFeatures::has_popcnt()) {
+      cout << setw(12) << bench(PopCount::popcnt, p, n, r4);
+    } else {
+      cout << setw(12) << "-";
+      r4 = r1;
+    }
+    if (PopCount::has_avx2()) {
+      cout << setw(12) << bench(PopCount::avx2, p, n, r2);
+    } else {
+      cout << setw(12) << "-";
+      r2 = r1;
+    }
+    if (PopCount::has_avx512()) {
+      cout << setw(12) << bench(PopCount::avx512, p, n, r3);
+    } else {
+      cout << setw(12) << "-";
+      r3 = r1;
+    }
+    cout << ((r1 == r2 && r1 == r3 && r1 == r4) ? "" : "   MISMATCH!") << endl;
+  }
+
+  return 0;
+}
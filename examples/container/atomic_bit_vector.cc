@@ -0,0 +1,90 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "include/container/atomic_bit_vector.h"
+#include "include/container/bit_vector.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Runs f(thread, op) for ops operations on each of t threads, and returns the
+// total number of millions of operations per second
+template <typename F>
+double run(size_t t, size_t ops, F f) {
+  vector<thread> threads;
+  const auto start = high_resolution_clock::now();
+  for (size_t i = 0; i < t; ++i) {
+    threads.emplace_back([i, ops, &f] {
+      mt19937_64 gen(i);
+      for (size_t j = 0; j < ops; ++j) {
+        f(gen());
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  return t * ops / duration<double>(high_resolution_clock::now() - start).count() / 1e6;
+}
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : ((size_t) 1 << 20);
+  const size_t max_threads = argc > 2 ? strtoull(argv[2], nullptr, 10) : 64;
+  const size_t ops = 1 << 20;
+
+  AtomicBitVector small(100);
+  cout << "First test_and_set(7): " << small.test_and_set(7) << endl;
+  cout << "Second test_and_set(7): " << small.test_and_set(7) << endl;
+  small.fetch_or(1, 0xff);
+  cout << "Set bits after fetch_or(1, 0xff): " << small.snapshot().num_set_bits() << endl;
+  cout << endl;
+
+  cout << "Random test-and-sets on " << n << " bits, " << ops << " per thread" << endl;
+  cout << setw(8) << "threads" << setw(12) << "mutex" << setw(12) << "atomic" <<
+       "   (M ops/s)" << endl;
+
+  for (size_t t = 1; t <= max_threads; t *= 2) {
+    BitVector locked(n);
+    mutex m;
+    const auto locked_rate = run(t, ops, [&](uint64_t r) {
+      lock_guard<mutex> lock(m);
+      auto b = locked.get_bit(r % n);
+      if (!b) {
+        b = true;
+      }
+    });
+
+    AtomicBitVector atomic(n);
+    const auto atomic_rate = run(t, ops, [&](uint64_t r) {
+      atomic.test_and_set(r % n);
+    });
+
+    cout << setw(8) << t << fixed << setprecision(2);
+    cout << setw(12) << locked_rate << setw(12) << atomic_rate << defaultfloat;
+    cout << (atomic.snapshot() == locked ? "" : "   MISMATCH!") << endl;
+  }
+
+  return 0;
+}
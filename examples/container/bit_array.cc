@@ -12,13 +12,88 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>
 #include <iomanip>
 #include <iostream>
+#include <random>
+#include <vector>
 
+#include "include/allocator/aligned.h"
 #include "include/container/bit_array.h"
 
 using namespace cpputil;
 using namespace std;
+using namespace std::chrono;
+
+// Returns the number of nanoseconds per call to f, which is called n times
+template <typename F>
+double time_per(size_t n, F f) {
+  const auto start = high_resolution_clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    f(i);
+  }
+  return duration<double, nano>(high_resolution_clock::now() - start).count() / n;
+}
+
+// Times the unrolled bit array kernels against the loops every bit string uses
+template <size_t N>
+void bench() {
+  typedef BitString < std::array < uint64_t, (N + 63) / 64 >> Generic;
+  const size_t count = 1024;
+  const size_t reps = 4096;
+
+  vector<BitArray<N>, Aligned<BitArray<N>, 32>> a(count);
+  vector<BitArray<N>, Aligned<BitArray<N>, 32>> b(count);
+  vector<BitArray<N>, Aligned<BitArray<N>, 32>> c(count);
+  mt19937_64 gen(0);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = 0; j < N; j += 8) {
+      a[i].get_bit(gen() % N) = true;
+      b[i].get_bit(gen() % N) = true;
+    }
+    c[i] = i % 2 ? a[i] : b[i];
+  }
+
+  size_t s1 = 0;
+  size_t s2 = 0;
+  const auto expr_g = time_per(count * reps, [&](size_t i) {
+    Generic& x = c[i % count];
+    x = (a[i % count] & b[i % count]) ^ x;
+  });
+  const auto expr_u = time_per(count * reps, [&](size_t i) {
+    c[i % count] = (a[i % count] & b[i % count]) ^ c[i % count];
+  });
+  const auto count_g = time_per(count * reps, [&](size_t i) {
+    s1 += static_cast<const Generic&>(c[i % count]).num_set_bits();
+  });
+  const auto count_u = time_per(count * reps, [&](size_t i) {
+    s2 += c[i % count].num_set_bits();
+  });
+  const auto eq_g = time_per(count * reps, [&](size_t i) {
+    s1 += static_cast<const Generic&>(a[i % count]) == c[i % count];
+  });
+  const auto eq_u = time_per(count * reps, [&](size_t i) {
+    s2 += a[i % count] == c[i % count];
+  });
+  const auto iter_g = time_per(count * reps / 16, [&](size_t i) {
+    const auto& x = c[i % count];
+    for (auto j = x.set_bit_index_begin(), je = x.set_bit_index_end(); j != je; ++j) {
+      s1 += *j;
+    }
+  });
+  const auto iter_u = time_per(count * reps / 16, [&](size_t i) {
+    c[i % count].for_each_set_bit([&](size_t j) {
+      s2 += j;
+    });
+  });
+
+  cout << setw(6) << N << fixed << setprecision(2);
+  cout << setw(10) << expr_g << setw(10) << expr_u;
+  cout << setw(10) << count_g << setw(10) << count_u;
+  cout << setw(10) << eq_g << setw(10) << eq_u;
+  cout << setw(10) << iter_g << setw(10) << iter_u;
+  cout << defaultfloat << (s1 == s2 ? "" : "   MISMATCH!") << endl;
+}
 
 int main() {
   BitArray<9 * 8> b1;
@@ -50,7 +125,7 @@ int main() {
   }
   cout << endl;
 
-  auto  b3 = ~b2;
+  BitArray<9 * 8> b3 = ~b2;
   for (auto i = b3.fixed_byte_begin(), ie = b3.fixed_byte_end(); i != ie; ++i) {
     cout << hex << setw(2) << setfill(' ') << (int) *i << " ";
   }
@@ -80,5 +155,17 @@ int main() {
   }
   cout << endl;
 
+  cout << endl;
+  cout << "Generic (g) versus unrolled (u) kernels, ns per operation" << endl;
+  cout << setw(6) << "bits" << setw(10) << "c=a&b^c g" << setw(10) << "u" <<
+       setw(10) << "count g" << setw(10) << "u" << setw(10) << "a==c g" << setw(10) << "u" <<
+       setw(10) << "iter g" << setw(10) << "u" << endl;
+  bench<64>();
+  bench<128>();
+  bench<256>();
+  bench<512>();
+  bench<1000>();
+  bench<1024>();
+
   return 0;
 }
@@ -0,0 +1,130 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "include/container/bit_lanes.h"
+#include "include/container/bit_vector.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Returns the number of milliseconds that reps calls to f take
+template <typename F>
+double elapsed(size_t reps, F f) {
+  const auto start = high_resolution_clock::now();
+  for (size_t i = 0; i < reps; ++i) {
+    f();
+  }
+  return duration<double>(high_resolution_clock::now() - start).count() * 1e3;
+}
+
+// Prints a row of the table
+void row(const char* name, double loop, double lanes, bool ok) {
+  cout << setw(24) << name << setw(12) << loop << setw(12) << lanes;
+  cout << (ok ? "" : "   MISMATCH!") << endl;
+}
+
+int main(int argc, char** argv) {
+  const size_t bytes = argc > 1 ? strtoull(argv[1], nullptr, 10) : (1 << 16);
+  const size_t reps = (1 << 28) / bytes + 1;
+
+  BitVector a(8 * bytes);
+  BitVector b(8 * bytes);
+  mt19937_64 gen(0);
+  for (auto i = a.fixed_quad_begin(), ie = a.fixed_quad_end(); i != ie; ++i) {
+    *i = gen();
+  }
+  for (auto i = b.fixed_quad_begin(), ie = b.fixed_quad_end(); i != ie; ++i) {
+    *i = gen();
+  }
+  // Keep the float lanes finite
+  for (size_t i = 0; i < a.num_float_singles(); ++i) {
+    a.get_float_single(i) = (float)(gen() % 1000);
+    b.get_float_single(i) = (float)(gen() % 1000);
+  }
+  BitVector c(a);
+  BitVector d(a);
+
+  cout << "Lane-wise operations on " << bytes << " bytes (ms for " << reps << " runs)" << endl;
+  cout << setw(24) << "op" << setw(12) << "loop" << setw(12) << "BitLanes" << endl;
+  cout << fixed << setprecision(2);
+
+  // Element-wise, one accessor call at a time, and with BitLanes
+  auto t1 = elapsed(reps, [&] {
+    for (size_t i = 0; i < c.num_fixed_bytes(); ++i) {
+      c.get_fixed_byte(i) += b.get_fixed_byte(i);
+    }
+  });
+  auto t2 = elapsed(reps, [&] {
+    BitLanes<uint8_t>::add(d, b);
+  });
+  row("add fixed bytes", t1, t2, c == d);
+
+  t1 = elapsed(reps, [&] {
+    for (size_t i = 0; i < c.num_fixed_words(); ++i) {
+      const uint16_t s = c.get_fixed_word(i) + b.get_fixed_word(i);
+      c.get_fixed_word(i) = s < b.get_fixed_word(i) ? 0xffff : s;
+    }
+  });
+  t2 = elapsed(reps, [&] {
+    BitLanes<uint16_t>::adds(d, b);
+  });
+  row("adds fixed words", t1, t2, c == d);
+
+  c = a;
+  d = a;
+  t1 = elapsed(reps, [&] {
+    for (size_t i = 0; i < c.num_float_doubles(); ++i) {
+      const auto x = c.get_float_double(i);
+      const auto y = b.get_float_double(i);
+      c.get_float_double(i) = x < y ? x : y;
+    }
+  });
+  t2 = elapsed(reps, [&] {
+    BitLanes<double>::min(d, b);
+  });
+  row("min float doubles", t1, t2, c == d);
+
+  BitVector m1(a.num_float_singles());
+  BitVector m2(a.num_float_singles());
+  t1 = elapsed(reps, [&] {
+    for (size_t i = 0; i < a.num_float_singles(); ++i) {
+      m1.get_bit(i) = a.get_float_single(i) > b.get_float_single(i);
+    }
+  });
+  t2 = elapsed(reps, [&] {
+    BitLanes<float>::cmpgt(a, b, m2);
+  });
+  row("cmpgt float singles", t1, t2, m1 == m2);
+
+  uint64_t s1 = 0;
+  uint64_t s2 = 0;
+  t1 = elapsed(reps, [&] {
+    for (size_t i = 0; i < a.num_fixed_bytes(); ++i) {
+      s1 += a.get_fixed_byte(i);
+    }
+  });
+  t2 = elapsed(reps, [&] {
+    s2 += BitLanes<uint8_t>::sum(a);
+  });
+  row("sum fixed bytes", t1, t2, s1 == s2);
+
+  return 0;
+}
@@ -0,0 +1,146 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "include/container/bit_array.h"
+#include "include/container/bit_matrix.h"
+#include "include/container/bit_vector.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Returns the number of seconds that f takes
+template <typename F>
+double elapsed(F f) {
+  const auto start = high_resolution_clock::now();
+  f();
+  return duration<double>(high_resolution_clock::now() - start).count();
+}
+
+// Transposes every 64x64 block of m with kernel k, and returns the number of
+// millions of blocks per second
+double blocks(const BitMatrix& m, BitTranspose::kernel_type k, size_t reps) {
+  const auto p = (const uint64_t*) m.bits().data();
+  const auto rb = (m.num_rows() + 63) / 64;
+  const auto cb = (m.num_cols() + 63) / 64;
+  vector<uint64_t> out(64 * cb * rb);
+
+  const auto secs = elapsed([&] {
+    for (size_t r = 0; r < reps; ++r) {
+      for (size_t i = 0; i < rb; ++i) {
+        for (size_t j = 0; j < cb; ++j) {
+          k(p + 64 * i * cb + j, cb, out.data() + 64 * j * rb + i, rb);
+        }
+      }
+    }
+  });
+  return reps * rb * cb / secs / 1e6;
+}
+
+int main(int argc, char** argv) {
+  const size_t cols = argc > 1 ? strtoull(argv[1], nullptr, 10) : 65536;
+  mt19937_64 gen(0);
+
+  // Feature masks, one 64-bit row per feature...
+  vector<BitArray<64>> masks(64);
+  for (auto& m : masks) {
+    m.unset();
+    for (size_t i = 0; i < 64; i += 1 + gen() % 8) {
+      m.get_bit(i) = true;
+    }
+  }
+  // ...go into a matrix row by row, and come out column by column
+  BitMatrix fm(64, 64);
+  for (size_t r = 0; r < 64; ++r) {
+    fm.set_row(r, masks[r]);
+  }
+  const auto ft = fm.transpose();
+  BitArray<64> col;
+  ft.get_row(5, col);
+  cout << "Features with bit 5 set: " << num_set_bits(col) << endl;
+  cout << endl;
+
+  // A wide matrix of random rows
+  BitMatrix m(64, cols);
+  BitVector row(cols);
+  for (size_t r = 0; r < 64; ++r) {
+    for (auto i = row.fixed_quad_begin(), ie = row.fixed_quad_end(); i != ie; ++i) {
+      *i = gen();
+    }
+    m.set_row(r, row);
+  }
+
+  // One bit at a time, and 64x64 blocks at a time
+  const auto& cm = m;
+  BitMatrix t1(cols, 64);
+  const auto slow = elapsed([&] {
+    for (size_t r = 0; r < m.num_rows(); ++r) {
+      for (size_t c = 0; c < m.num_cols(); ++c) {
+        t1.get_bit(c, r) = cm.get_bit(r, c);
+      }
+    }
+  });
+  BitMatrix t2(cols, 64);
+  const auto fast = elapsed([&] {
+    m.transpose_into(t2);
+  });
+  cout << "Transposing 64 x " << cols << " bits" << endl;
+  cout << "  get_bit:      " << fixed << setprecision(6) << slow << " s" << endl;
+  cout << "  transpose:    " << fast << " s";
+  cout << (t1.bits() == t2.bits() ? "" : "   MISMATCH!") << endl;
+
+  // Columns gathered 64 rows at a time
+  BitVector c1(64);
+  BitVector c2(64);
+  size_t sum1 = 0;
+  size_t sum2 = 0;
+  const auto col_slow = elapsed([&] {
+    for (size_t c = 0; c < m.num_cols(); ++c) {
+      for (size_t r = 0; r < m.num_rows(); ++r) {
+        c1.get_bit(r) = cm.get_bit(r, c);
+      }
+      sum1 += c1.num_set_bits();
+    }
+  });
+  const auto col_fast = elapsed([&] {
+    for (size_t c = 0; c < m.num_cols(); ++c) {
+      m.get_column(c, c2);
+      sum2 += c2.num_set_bits();
+    }
+  });
+  cout << "Gathering " << cols << " columns" << endl;
+  cout << "  get_bit:      " << col_slow << " s" << endl;
+  cout << "  get_column:   " << col_fast << " s" << (sum1 == sum2 ? "" : "   MISMATCH!") << endl;
+  cout << endl;
+
+  // Every version of the block kernel that this host can run, on a matrix
+  // that fits in cache
+  BitMatrix sq(256, 256);
+  const auto reps = 100000;
+  cout << "64x64 blocks per second (millions)" << endl;
+  cout << setprecision(2);
+  cout << setw(8) << "scalar" << setw(8) << blocks(sq, BitTranspose::scalar, reps) << endl;
+  if (CpuFeatures::has_avx2()) {
+    cout << setw(8) << "avx2" << setw(8) << blocks(sq, BitTranspose::avx2, reps) << endl;
+  }
+
+  return 0;
+}
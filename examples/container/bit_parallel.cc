@@ -0,0 +1,88 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "include/container/bit_parallel.h"
+#include "include/container/bit_vector.h"
+#include "include/system/thread_pool.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Returns the number of GB/s achieved by f, which touches the given number of bytes
+template <typename F>
+double bandwidth(size_t bytes, F f) {
+  const auto start = high_resolution_clock::now();
+  f();
+  return bytes / duration<double>(high_resolution_clock::now() - start).count() / 1e9;
+}
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : ((size_t) 1 << 32);
+  const size_t max_threads = argc > 2 ? strtoull(argv[2], nullptr, 10) :
+                             max(1u, thread::hardware_concurrency());
+  const auto bytes = n / 8;
+
+  BitVector b1(n);
+  BitVector b2(n);
+  mt19937_64 gen(0);
+  for (auto i = b1.fixed_quad_begin(), ie = b1.fixed_quad_end(); i != ie; ++i) {
+    *i = gen();
+  }
+  for (auto i = b2.fixed_quad_begin(), ie = b2.fixed_quad_end(); i != ie; ++i) {
+    *i = gen();
+  }
+  const auto expected = num_set_bits(b1 ^ b2);
+
+  cout << "Bulk operations on " << n << " bits (" << (bytes >> 20) << " MiB per vector)" << endl;
+  cout << setw(8) << "threads" << setw(10) << "or" << setw(10) << "xor" << setw(10) << "not" <<
+       setw(10) << "copy" << setw(10) << "popcount" << setw(10) << "fill" << "   (GB/s)" << endl;
+
+  for (size_t t = 1; t <= max_threads; t *= 2) {
+    ThreadPool pool(t);
+    BitParallel par(pool);
+    BitVector b3(n);
+    size_t count = 0;
+
+    cout << setw(8) << t << fixed << setprecision(2);
+    cout << setw(10) << bandwidth(3 * bytes, [&] {
+      par.assign(b3, b1 | b2);
+    });
+    cout << setw(10) << bandwidth(3 * bytes, [&] {
+      par.assign(b3, b1 ^ b2);
+    });
+    cout << setw(10) << bandwidth(2 * bytes, [&] {
+      par.assign(b3, ~b3);
+    });
+    cout << setw(10) << bandwidth(2 * bytes, [&] {
+      par.copy(b3, b1);
+    });
+    cout << setw(10) << bandwidth(2 * bytes, [&] {
+      count = par.num_set_bits(b1 ^ b2);
+    });
+    cout << setw(10) << bandwidth(bytes, [&] {
+      par.fill(b3, false);
+    });
+    cout << defaultfloat << (count == expected && !any_set_bits(b3) ? "" : "   MISMATCH!") << endl;
+  }
+
+  return 0;
+}
@@ -50,7 +50,7 @@ int main() {
   }
   cout << endl;
 
-  auto  b3 = ~b2;
+  BitVector b3 = ~b2;
   for (auto i = b3.fixed_byte_begin(), ie = b3.fixed_byte_end(); i != ie; ++i) {
     cout << hex << setw(2) << setfill(' ') << (int) *i << " ";
   }
@@ -62,5 +62,32 @@ int main() {
   }
   cout << endl;
 
+  // Evaluated in a single pass, without temporaries
+  b3 = (b1 & b2) | ~b3;
+  for (auto i = b3.fixed_byte_begin(), ie = b3.fixed_byte_end(); i != ie; ++i) {
+    cout << hex << setw(2) << setfill(' ') << (int) *i << " ";
+  }
+  cout << endl;
+
+  // Reductions that don't build a temporary
+  cout << dec;
+  cout << "|b1 & b3| = " << b1.intersect_count(b3) << endl;
+  cout << "|b1 | b3| = " << b1.union_count(b3) << endl;
+  cout << "|b1 ^ b3| = " << b1.xor_count(b3) << endl;
+  cout << "b1 <= b3: " << (b1.is_subset_of(b3) ? "true" : "false") << endl;
+  cout << "|b1 & ~b2| = " << num_set_bits(b1 & ~b2) << endl;
+
+  // Range operations a quad at a time
+  BitVector b4(100);
+  b4.set_range(10, 90);
+  b4.flip_range(40, 50);
+  b4.reset_range(80, 100);
+  b4 >>= 5;
+  b4.copy_bits(b4, 0, 70, 30);
+  for (size_t i = 0; i < b4.num_bits(); ++i) {
+    cout << b4[i];
+  }
+  cout << endl;
+
   return 0;
 }
@@ -0,0 +1,97 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "include/container/bit_vector.h"
+#include "include/container/compressed_bit_vector.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Returns a bit vector with roughly n * d randomly chosen bits set
+BitVector random_bits(size_t n, double d, mt19937_64& gen) {
+  BitVector bv(n);
+  const auto k = (size_t)(n * d);
+  for (size_t i = 0; i < k; ++i) {
+    bv.get_bit(gen() % n) = true;
+  }
+  return bv;
+}
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : ((size_t) 1 << 28);
+  const size_t reps = 5;
+  mt19937_64 gen(0);
+
+  CompressedBitVector c(1000);
+  c.get_bit(1) = true;
+  c.get_bit(500) = true;
+  c.get_bit(501) = true;
+  cout << "Set bits: ";
+  for (auto i = c.set_bit_index_begin(), ie = c.set_bit_index_end(); i != ie; ++i) {
+    cout << *i << " ";
+  }
+  cout << "(" << c.num_set_bits() << " total)" << endl;
+  cout << endl;
+
+  cout << "Universe of " << n << " bits; intersection times are averaged over " << reps <<
+       " runs" << endl;
+  cout << setw(10) << "density" << setw(14) << "BitVector" << setw(14) << "Compressed" <<
+       setw(14) << "BitVector" << setw(14) << "Compressed" << endl;
+  cout << setw(10) << "(%)" << setw(14) << "(bytes)" << setw(14) << "(bytes)" <<
+       setw(14) << "(ms)" << setw(14) << "(ms)" << endl;
+
+  for (auto d : {0.00001, 0.0001, 0.001, 0.01, 0.1, 0.5}) {
+    const auto a = random_bits(n, d, gen);
+    const auto b = random_bits(n, d, gen);
+    CompressedBitVector ca(a);
+    CompressedBitVector cb(b);
+    ca.run_optimize();
+    cb.run_optimize();
+
+    // Each rep copies its left operand before starting the clock, so that
+    // both columns time only the in-place intersection
+    BitVector r(n);
+    auto bv_ms = 0.0;
+    for (size_t i = 0; i < reps; ++i) {
+      r = a;
+      const auto start = high_resolution_clock::now();
+      r &= b;
+      bv_ms += duration<double, milli>(high_resolution_clock::now() - start).count() / reps;
+    }
+
+    CompressedBitVector cr;
+    auto cbv_ms = 0.0;
+    for (size_t i = 0; i < reps; ++i) {
+      cr = ca;
+      const auto start = high_resolution_clock::now();
+      cr &= cb;
+      cbv_ms += duration<double, milli>(high_resolution_clock::now() - start).count() / reps;
+    }
+
+    cout << setw(10) << (100 * d);
+    cout << setw(14) << (r.num_fixed_quads() * sizeof(uint64_t)) << setw(14) << ca.num_bytes();
+    cout << setw(14) << fixed << setprecision(3) << bv_ms << setw(14) << cbv_ms;
+    cout << defaultfloat;
+    cout << (r.num_set_bits() == cr.num_set_bits() ? "" : "   MISMATCH!") << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,87 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "include/container/bit_vector.h"
+#include "include/container/mapped_bit_vector.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Returns the number of milliseconds it takes to run f
+template <typename F>
+double time(F f) {
+  const auto start = high_resolution_clock::now();
+  f();
+  return duration<double, milli>(high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : ((size_t) 1 << 31);
+  const string path = argc > 2 ? argv[2] : "/tmp/cpputil_mapped_bit_vector.bits";
+
+  BitVector bv(n);
+  mt19937_64 gen(0);
+  for (auto i = bv.fixed_quad_begin(), ie = bv.fixed_quad_end(); i != ie; ++i) {
+    *i = gen();
+  }
+  if (!MappedBitVector::save(bv, path)) {
+    cout << "Unable to write " << path << endl;
+    return 1;
+  }
+  cout << "Saved " << n << " bits to " << path << endl;
+
+  // The way things were done before: read the whole file into memory
+  BitVector read(n);
+  const auto read_ms = time([&] {
+    ifstream ifs(path, ios::binary);
+    ifs.seekg(64);
+    ifs.read((char*) read.data(), (n + 63) / 64 * 8);
+  });
+
+  ConstMappedBitVector mapped;
+  const auto map_ms = time([&] {
+    mapped.open(path);
+  });
+  size_t count = 0;
+  const auto count_ms = time([&] {
+    count = mapped.bits().num_set_bits();
+  });
+
+  cout << fixed << setprecision(3);
+  cout << "Read into a BitVector: " << read_ms << " ms" << endl;
+  cout << "Mapped:                " << map_ms << " ms" << endl;
+  cout << "First num_set_bits() on the mapping: " << count_ms << " ms" << endl;
+  cout << "Mapping matches: " << (mapped.is_open() && count == bv.num_set_bits() &&
+                                  !any_set_bits(mapped.bits() ^ read) ? "yes" : "no") << endl;
+
+  // Private writes don't reach the file
+  MappedBitVector cow(path);
+  cow.reset_range(0, cow.num_bits());
+  cout << "Set bits after clearing a copy-on-write mapping: " << cow.num_set_bits() << endl;
+  cout << "Set bits in a fresh mapping of the file: " <<
+       ConstMappedBitVector(path).bits().num_set_bits() << endl;
+
+  remove(path.c_str());
+  return 0;
+}
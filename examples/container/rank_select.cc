@@ -0,0 +1,79 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "include/container/bit_vector.h"
+#include "include/container/rank_select.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : ((size_t) 1 << 30);
+  const size_t queries = 1 << 22;
+
+  BitVector bv(n);
+  mt19937_64 gen(0);
+  for (auto i = bv.fixed_quad_begin(), ie = bv.fixed_quad_end(); i != ie; ++i) {
+    *i = gen() & gen();
+  }
+
+  auto start = high_resolution_clock::now();
+  RankSelect rs(bv);
+  const auto build_ms = duration<double, milli>(high_resolution_clock::now() - start).count();
+
+  cout << "Bits: " << rs.num_bits() << " (" << rs.num_set_bits() << " set)" << endl;
+  cout << "Index overhead: " << (100.0 * rs.num_bytes() / (n / 8)) << "%" << endl;
+  cout << "Build time: " << build_ms << " ms" << endl;
+
+  // Check a few answers against a linear walk
+  size_t k = 0;
+  bool ok = true;
+  for (auto i = bv.set_bit_index_begin(), ie = bv.set_bit_index_end(); i != ie && k < 100000; ++i, ++k) {
+    ok &= rs.select(k) == *i && rs.rank(*i) == k;
+  }
+  cout << "Agrees with set_bit_index_iterator: " << (ok ? "yes" : "no") << endl;
+
+  vector<size_t> is(queries);
+  vector<size_t> ks(queries);
+  for (size_t i = 0; i < queries; ++i) {
+    is[i] = gen() % n;
+    ks[i] = gen() % rs.num_set_bits();
+  }
+
+  size_t sum = 0;
+  start = high_resolution_clock::now();
+  for (auto i : is) {
+    sum += rs.rank(i);
+  }
+  const auto rank_ns = duration<double, nano>(high_resolution_clock::now() - start).count() / queries;
+
+  start = high_resolution_clock::now();
+  for (auto k : ks) {
+    sum += rs.select(k);
+  }
+  const auto select_ns = duration<double, nano>(high_resolution_clock::now() - start).count() / queries;
+
+  cout << "rank: " << rank_ns << " ns/query" << endl;
+  cout << "select: " << select_ns << " ns/query" << endl;
+  cout << "(checksum " << sum << ")" << endl;
+
+  return 0;
+}
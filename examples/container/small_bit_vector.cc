@@ -0,0 +1,103 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "include/container/bit_vector.h"
+#include "include/container/small_bit_vector.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Builds a bit vector of n bits for each of the given bit lists, combines
+// neighbours, and moves the results into a vector. Returns the number of
+// millions of bit vectors created per second, and the checksum in sum.
+template <typename T>
+double churn(const vector<vector<size_t>>& bits, size_t n, size_t& sum) {
+  const auto start = high_resolution_clock::now();
+
+  vector<T> res;
+  res.reserve(bits.size());
+  T prev(n);
+  for (const auto& bs : bits) {
+    T t(n);
+    for (auto b : bs) {
+      t.get_bit(b) = true;
+    }
+    T u = t | prev;
+    prev = std::move(t);
+    res.push_back(std::move(u));
+  }
+  sum = 0;
+  for (const auto& r : res) {
+    sum += num_set_bits(r);
+  }
+
+  const auto time = duration<double>(high_resolution_clock::now() - start).count();
+  return 2 * bits.size() / time / 1e6;
+}
+
+int main(int argc, char** argv) {
+  const size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+  // Small bit vectors live inside the object...
+  SmallBitVector<4> s1(200);
+  s1.get_bit(3) = true;
+  s1.get_bit(199) = true;
+  cout << "200 bits:  " << (s1.is_inline() ? "inline" : "heap") <<
+       ", " << num_set_bits(s1) << " bits set" << endl;
+
+  // ...until they grow too large, at which point they move to the heap.
+  s1.resize_for_bits(300);
+  cout << "300 bits:  " << (s1.is_inline() ? "inline" : "heap") <<
+       ", " << num_set_bits(s1) << " bits still set" << endl;
+
+  // Moving a heap bit vector hands over its quads instead of copying them.
+  const auto p = s1.data();
+  auto s2 = std::move(s1);
+  cout << "moved:     " << (s2.data() == p ? "same quads" : "copied") << endl;
+  cout << endl;
+
+  // Many short-lived bit vectors, with and without the heap.
+  mt19937_64 gen(0);
+  cout << "Creating " << 2 * count << " bit vectors (millions per second)" << endl;
+  cout << setw(8) << "bits" << setw(16) << "BitVector" << setw(16) << "SmallBitVector" << endl;
+  for (size_t n : {
+         64, 128, 256, 512
+       }) {
+    vector<vector<size_t>> bits(count);
+    for (auto& bs : bits) {
+      for (size_t i = 0; i < 4; ++i) {
+        bs.push_back(gen() % n);
+      }
+    }
+
+    size_t sum1 = 0;
+    size_t sum2 = 0;
+    const auto t1 = churn<BitVector>(bits, n, sum1);
+    const auto t2 = churn<SmallBitVector<4>>(bits, n, sum2);
+
+    cout << setw(8) << n << fixed << setprecision(2) << setw(16) << t1 << setw(16) << t2;
+    cout << defaultfloat << (sum1 == sum2 ? "" : "   MISMATCH!") << endl;
+  }
+
+  return 0;
+}
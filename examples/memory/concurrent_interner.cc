@@ -0,0 +1,103 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/memory/concurrent_interner.h"
+#include "include/memory/interner.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// A stream of log-like strings, most of which repeat: the ids are skewed, so
+// that a few of them make up most of the stream
+vector<string> stream(size_t n, size_t distinct) {
+  const char* verbs[] = {"GET", "PUT", "POST", "DELETE"};
+  mt19937_64 gen(0);
+  uniform_real_distribution<double> u(0, 1);
+  vector<string> res;
+  res.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    const auto x = u(gen);
+    const auto id = (size_t)(distinct * x * x * x);
+    res.push_back(string(verbs[id % 4]) + " /api/v1/users/" + to_string(id) + "/profile");
+  }
+  return res;
+}
+
+// Interns the stream on t threads, each taking every t-th string, and
+// returns millions of strings per second
+template <typename F>
+double run(const vector<string>& s, size_t t, F intern) {
+  const auto start = high_resolution_clock::now();
+  vector<thread> threads;
+  for (size_t i = 0; i < t; ++i) {
+    threads.emplace_back([&s, &intern, i, t] {
+      for (size_t j = i; j < s.size(); j += t) {
+        intern(s[j]);
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  return s.size() / duration<double>(high_resolution_clock::now() - start).count() / 1e6;
+}
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+  const size_t max_threads = argc > 2 ? strtoull(argv[2], nullptr, 10) : 64;
+  const auto s = stream(n, 100000);
+
+  cout << "Interning " << n << " strings (millions per second)" << endl;
+  cout << setw(8) << "threads" << setw(16) << "locked" << setw(16) << "concurrent" << endl;
+  cout << fixed << setprecision(2);
+  for (size_t t = 1; t <= max_threads; t *= 2) {
+    // An Interner behind one lock...
+    Interner<string> in;
+    mutex m;
+    const auto t1 = run(s, t, [&in, &m](const string& x) {
+      lock_guard<mutex> lock(m);
+      in.intern(x);
+    });
+    // ...and a concurrent one
+    ConcurrentInterner<string> ci;
+    const auto t2 = run(s, t, [&ci](const string& x) {
+      ci.intern(x);
+    });
+
+    cout << setw(8) << t << setw(16) << t1 << setw(16) << t2;
+    cout << (in.size() == ci.size() ? "" : "   MISMATCH!") << endl;
+  }
+
+  // References are stable, so equal strings intern to the same address
+  ConcurrentInterner<string> ci;
+  const auto& a = ci.intern("Hello");
+  for (size_t i = 0; i < 100000; ++i) {
+    ci.intern(to_string(i));
+  }
+  cout << (&a == &ci.intern(string("Hello")) ? "Stable references" : "Something is broken!");
+  cout << endl;
+
+  return 0;
+}
@@ -15,6 +15,7 @@
 #include <iostream>
 #include <string>
 
+#include "include/container/bit_vector.h"
 #include "include/memory/interner.h"
 
 using namespace cpputil;
@@ -49,5 +50,18 @@ int main() {
     i.clear();
   }
 
+  // Bit vectors hash their quads with the dispatched kernels, so they can be
+  // interned as well; padding bits don't affect equality or the hash
+  Interner<BitVector> bi;
+  BitVector b1(100);
+  BitVector b2(100);
+  b1.get_bit(7) = true;
+  b2.get_bit(7) = true;
+  if (&bi.intern(b1) == &bi.intern(b2)) {
+    cout << "These are the same bit vector!" << endl;
+  } else {
+    cout << "Something is broken!" << endl;
+  }
+
   return 0;
 }
@@ -0,0 +1,101 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "include/allocator/aligned.h"
+#include "include/bits/bit_kernels.h"
+#include "include/system/cpu_features.h"
+
+using namespace cpputil;
+using namespace std;
+using namespace std::chrono;
+
+// Returns the number of GB/s achieved by reps calls to f, which touches the given number of bytes
+template <typename F>
+double bandwidth(size_t bytes, size_t reps, F f) {
+  const auto start = high_resolution_clock::now();
+  for (size_t i = 0; i < reps; ++i) {
+    f();
+  }
+  return reps * bytes / duration<double>(high_resolution_clock::now() - start).count() / 1e9;
+}
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4096;
+  const size_t reps = (1 << 28) / (8 * n + 1) + 1;
+
+  // The level is detected once; CPPUTIL_SIMD=sse2 or avx2 caps it
+  cout << "Dispatched kernels use " << CpuFeatures::name(CpuFeatures::level()) << endl;
+  cout << endl;
+
+  vector<uint64_t, Aligned<uint64_t, 32>> a(n);
+  vector<uint64_t, Aligned<uint64_t, 32>> b(n);
+  mt19937_64 gen(0);
+  for (size_t i = 0; i < n; ++i) {
+    a[i] = gen();
+    b[i] = a[i];
+  }
+
+  // Every version of every kernel that this host can run
+  cout << "Kernels over " << n << " quads" << endl;
+  cout << setw(8) << "level" << setw(10) << "and" << setw(10) << "or" << setw(10) << "xor" <<
+       setw(10) << "equal" << setw(10) << "not" << setw(10) << "hash" <<
+       "   (GB/s)" << endl;
+  for (auto l : {
+         SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512
+       }) {
+    if (l > CpuFeatures::level()) {
+      continue;
+    }
+    const auto t = BitKernels::table(l);
+    auto ok = true;
+
+    cout << setw(8) << CpuFeatures::name(l) << fixed << setprecision(2);
+    cout << setw(10) << bandwidth(16 * n, reps, [&] {
+      t.and_into(a.data(), b.data(), n);
+    });
+    cout << setw(10) << bandwidth(16 * n, reps, [&] {
+      t.or_into(a.data(), b.data(), n);
+    });
+    // Xor twice, so that a still equals b afterwards
+    cout << setw(10) << bandwidth(16 * n, reps, [&] {
+      t.xor_into(a.data(), b.data(), n);
+      t.xor_into(a.data(), b.data(), n);
+    }) * 2;
+    cout << setw(10) << bandwidth(16 * n, reps, [&] {
+      ok &= t.equal(a.data(), b.data(), n);
+    });
+    // Flip twice in place, so that a still equals b afterwards
+    cout << setw(10) << bandwidth(8 * n, reps, [&] {
+      t.not_into(a.data(), a.data(), n, false);
+      t.not_into(a.data(), a.data(), n, false);
+    }) * 2;
+    ok &= t.equal(a.data(), b.data(), n);
+    uint64_t h = 0;
+    cout << setw(10) << bandwidth(8 * n, reps, [&] {
+      h = t.hash(a.data(), n, h);
+    });
+    // Every level computes the same hash
+    ok &= t.hash(a.data(), n, 0) == BitKernels::table(SimdLevel::SSE2).hash(a.data(), n, 0);
+    cout << defaultfloat << (ok ? "" : "   MISMATCH!") << endl;
+  }
+
+  return 0;
+}
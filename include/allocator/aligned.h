@@ -29,7 +29,7 @@ class Aligned {
 		~Aligned() { }
 		Aligned(const Aligned& rhs) { }
 		template<typename T2>
-		Aligned(const Aligned<T2>& rhs) { }
+		Aligned(const Aligned<T2, N>& rhs) { }
 
 		pointer address (reference r) {
 			return &r;
@@ -0,0 +1,39 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_ALLOCATOR_ALIGNMENT_H
+#define CPPUTIL_INCLUDE_ALLOCATOR_ALIGNMENT_H
+
+#include <cstddef>
+#include <type_traits>
+
+#include "include/allocator/aligned.h"
+
+namespace cpputil {
+
+/* The alignment that every block from allocator A is guaranteed to have.
+ * Allocators that don't say otherwise, like std::allocator, are assumed to
+ * align only as much as malloc does. Each allocator in this directory
+ * specializes this with its alignment parameter, and an allocator from
+ * elsewhere can do the same. */
+template <typename A>
+struct allocator_alignment : public std::integral_constant<size_t, alignof(std::max_align_t)> { };
+
+template <typename T, size_t N>
+struct allocator_alignment<Aligned<T, N>> :
+  public std::integral_constant<size_t, (N > alignof(T) ? N : alignof(T))> { };
+
+} // namespace cpputil
+
+#endif
@@ -0,0 +1,239 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_ALLOCATOR_ARENA_H
+#define CPPUTIL_INCLUDE_ALLOCATOR_ARENA_H
+
+#include <cassert>
+#include <cstdlib>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "include/allocator/alignment.h"
+
+namespace cpputil {
+
+/* A monotonic memory resource. Blocks are carved out of large chunks by
+ * bumping a pointer, and are only given back all at once, by reset() or the
+ * destructor. Each chunk is twice the size of the one before it, up to
+ * MAX_CHUNK bytes, so a steady workload settles into a single chunk. An arena
+ * is not thread-safe. */
+class Arena {
+ public:
+  enum : size_t {
+    MAX_CHUNK = 1 << 26
+  };
+
+  /** Makes an arena the one that default-constructed Monotonic allocators on
+   * this thread use, for as long as the scope lives. Scopes nest. */
+  class Scope {
+   public:
+    /** Installs arena. */
+    explicit Scope(Arena& arena) : outer_(current_ref()) {
+      current_ref() = &arena;
+    }
+    /** Restores the arena that was installed before this one. */
+    ~Scope() {
+      current_ref() = outer_;
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    Arena* outer_;
+  };
+
+  /** Creates an arena whose first chunk holds n bytes. No memory is taken
+   * until the first allocation. */
+  explicit Arena(size_t n = 4096) :
+    head_(nullptr), top_(0), end_(0), next_(n), capacity_(0) { }
+  /** Frees every chunk. */
+  ~Arena() {
+    release(nullptr);
+  }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /** Returns n bytes aligned to align, which must be a power of two. */
+  void* allocate(size_t n, size_t align) {
+    assert((align & (align - 1)) == 0);
+    auto p = (top_ + align - 1) & ~(uintptr_t)(align - 1);
+    if (head_ == nullptr || p + n > end_) {
+      grow(n + align);
+      p = (top_ + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    top_ = p + n;
+    return (void*) p;
+  }
+  /** Gives back the n bytes at p if they are the last ones that were handed
+   * out, which lets a growing container reuse its old block. Anything else is
+   * kept until reset(). */
+  void deallocate(void* p, size_t n) {
+    if ((uintptr_t) p + n == top_) {
+      top_ = (uintptr_t) p;
+    }
+  }
+  /** Gives back every block at once. The newest chunk is kept for reuse and
+   * the others are freed. Nothing that was allocated may be used afterwards. */
+  void reset() {
+    if (head_ != nullptr) {
+      release(head_);
+      top_ = (uintptr_t)(head_ + 1);
+    }
+  }
+
+  /** Returns the number of bytes held in chunks. */
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  /** Returns the arena of the innermost Scope on this thread, or nullptr. */
+  static Arena* current() {
+    return current_ref();
+  }
+  /** Returns an arena that belongs to the calling thread. */
+  static Arena& local() {
+    static thread_local Arena a(1 << 16);
+    return a;
+  }
+
+ private:
+  /** The header at the front of each chunk. */
+  struct Chunk {
+    Chunk* next;
+    size_t size;
+  };
+
+  Chunk* head_;
+  uintptr_t top_;
+  uintptr_t end_;
+  size_t next_;
+  size_t capacity_;
+
+  /** Starts a chunk with room for at least n bytes. */
+  void grow(size_t n) {
+    const auto size = std::max(next_, n + sizeof(Chunk));
+    const auto c = (Chunk*) malloc(size);
+    assert(c != nullptr);
+
+    c->next = head_;
+    c->size = size;
+    head_ = c;
+    top_ = (uintptr_t)(c + 1);
+    end_ = (uintptr_t) c + size;
+    next_ = std::min(2 * next_, (size_t) MAX_CHUNK);
+    capacity_ += size;
+  }
+  /** Frees every chunk after keep, or every chunk if keep is nullptr. */
+  void release(Chunk* keep) {
+    auto c = keep == nullptr ? head_ : keep->next;
+    while (c != nullptr) {
+      const auto next = c->next;
+      capacity_ -= c->size;
+      free(c);
+      c = next;
+    }
+    if (keep == nullptr) {
+      head_ = nullptr;
+      top_ = end_ = 0;
+    } else {
+      keep->next = nullptr;
+    }
+  }
+
+  /** Holds the arena of the innermost Scope on this thread. */
+  static Arena*& current_ref() {
+    static thread_local Arena* a = nullptr;
+    return a;
+  }
+};
+
+/* An allocator that takes its blocks from an Arena, aligned to N bytes, and
+ * never frees them individually. Copies and rebinds share the arena, and two
+ * allocators are equal if they share one. A default-constructed allocator
+ * uses the arena of the innermost Arena::Scope on the calling thread, which
+ * is what lets containers that build their own allocators, like the maps
+ * inside a Tokenizer, work out of an arena. Outside of any scope it falls
+ * back to the calling thread's Arena::local(), the same arena that Bump
+ * uses, whose memory is only reclaimed by Bump::reset(). */
+template <typename T, size_t N = 16>
+class Monotonic {
+ public:
+  static_assert((N & (N - 1)) == 0, "Alignment must be a power of two");
+
+  typedef T value_type;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+
+  template <typename T2>
+  struct rebind {
+    typedef Monotonic<T2, N> other;
+  };
+
+  /** Allocates from the arena of the innermost Arena::Scope, or from
+   * Arena::local() if there isn't one. */
+  Monotonic() : arena_(Arena::current() != nullptr ? Arena::current() : &Arena::local()) { }
+  /** Allocates from arena. */
+  explicit Monotonic(Arena& arena) : arena_(&arena) { }
+  /** Rebinding constructor. */
+  template <typename T2>
+  Monotonic(const Monotonic<T2, N>& rhs) : arena_(rhs.arena()) { }
+
+  /** Returns space for n values. */
+  pointer allocate(size_type n) {
+    return (pointer) arena_->allocate(n * sizeof(T), N > alignof(T) ? N : alignof(T));
+  }
+  /** Gives the space back to the arena if it was the last block. */
+  void deallocate(pointer p, size_type n) {
+    arena_->deallocate(p, n * sizeof(T));
+  }
+  /** Returns the largest number of values that can be allocated. */
+  size_type max_size() const {
+    return std::numeric_limits<size_type>::max() / sizeof(T);
+  }
+
+  /** Returns the arena that this allocator uses. */
+  Arena* arena() const {
+    return arena_;
+  }
+
+  template <typename T2>
+  bool operator==(const Monotonic<T2, N>& rhs) const {
+    return arena_ == rhs.arena();
+  }
+  template <typename T2>
+  bool operator!=(const Monotonic<T2, N>& rhs) const {
+    return !(*this == rhs);
+  }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, size_t N>
+struct allocator_alignment<Monotonic<T, N>> :
+  public std::integral_constant<size_t, (N > alignof(T) ? N : alignof(T))> { };
+
+} // namespace cpputil
+
+#endif
@@ -0,0 +1,89 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_ALLOCATOR_BUMP_H
+#define CPPUTIL_INCLUDE_ALLOCATOR_BUMP_H
+
+#include <stddef.h>
+
+#include <limits>
+
+#include "include/allocator/alignment.h"
+#include "include/allocator/arena.h"
+
+namespace cpputil {
+
+/* An allocator that takes its blocks from the calling thread's Arena::local(),
+ * aligned to N bytes. It has no state, so it can stand in for Aligned
+ * anywhere, and a block can be freed on any thread. Blocks are reclaimed all
+ * at once by reset(), which must only be called when no container on this
+ * thread still holds memory from it; the usual pattern is one reset() at the
+ * end of each unit of work. */
+template <typename T, size_t N = 16>
+class Bump {
+ public:
+  static_assert((N & (N - 1)) == 0, "Alignment must be a power of two");
+
+  typedef T value_type;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+
+  template <typename T2>
+  struct rebind {
+    typedef Bump<T2, N> other;
+  };
+
+  Bump() { }
+  template <typename T2>
+  Bump(const Bump<T2, N>&) { }
+
+  /** Returns space for n values. */
+  pointer allocate(size_type n) {
+    return (pointer) Arena::local().allocate(n * sizeof(T), N > alignof(T) ? N : alignof(T));
+  }
+  /** Gives the space back if it was the last block this thread handed out. */
+  void deallocate(pointer p, size_type n) {
+    Arena::local().deallocate(p, n * sizeof(T));
+  }
+  /** Returns the largest number of values that can be allocated. */
+  size_type max_size() const {
+    return std::numeric_limits<size_type>::max() / sizeof(T);
+  }
+
+  /** Reclaims every block that was allocated on this thread. */
+  static void reset() {
+    Arena::local().reset();
+  }
+
+  template <typename T2>
+  bool operator==(const Bump<T2, N>&) const {
+    return true;
+  }
+  template <typename T2>
+  bool operator!=(const Bump<T2, N>&) const {
+    return false;
+  }
+};
+
+template <typename T, size_t N>
+struct allocator_alignment<Bump<T, N>> :
+  public std::integral_constant<size_t, (N > alignof(T) ? N : alignof(T))> { };
+
+} // namespace cpputil
+
+#endif
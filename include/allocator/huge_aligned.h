@@ -0,0 +1,217 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_ALLOCATOR_HUGE_ALIGNED_H
+#define CPPUTIL_INCLUDE_ALLOCATOR_HUGE_ALIGNED_H
+
+#include <cassert>
+#include <cstdlib>
+#include <linux/mempolicy.h>
+#include <linux/mman.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <limits>
+
+#include "include/allocator/alignment.h"
+
+namespace cpputil {
+
+/* How large blocks are backed. */
+enum class HugePages {
+  /** Regular pages. */
+  NONE,
+  /** Transparent huge pages, by way of madvise(MADV_HUGEPAGE). */
+  TRANSPARENT,
+  /** 2 MiB pages from the hugetlbfs pool, or TRANSPARENT if the pool has none. */
+  EXPLICIT
+};
+
+/* Which NUMA nodes large blocks are placed on. */
+enum class NumaPolicy {
+  /** Wherever the kernel's policy for the thread puts them. */
+  DEFAULT,
+  /** On one node. */
+  BIND,
+  /** Round robin across every node, page by page. */
+  INTERLEAVE
+};
+
+/* Maps blocks of memory that are large enough to be worth huge pages. Blocks
+ * are whole multiples of 2 MiB and start on a 2 MiB boundary. Every request
+ * for huge pages or a NUMA placement is advice: if the kernel can't honor it,
+ * the block is backed by regular pages on whichever node the kernel picks. */
+class HugeMapping {
+ public:
+  enum : size_t {
+    HUGE_PAGE = 2 * 1024 * 1024
+  };
+
+  /** Returns a block of at least n bytes. */
+  static void* map(size_t n, HugePages h, NumaPolicy p, unsigned node) {
+    const auto len = round(n);
+    void* res = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (h == HugePages::EXPLICIT) {
+      res = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | huge_page_size(), -1, 0);
+    }
+#endif
+    if (res == MAP_FAILED) {
+      res = map_aligned(len);
+#ifdef MADV_HUGEPAGE
+      if (h != HugePages::NONE) {
+        madvise(res, len, MADV_HUGEPAGE);
+      }
+#endif
+    }
+    place(res, len, p, node);
+    return res;
+  }
+  /** Unmaps a block of n bytes. */
+  static void unmap(void* p, size_t n) {
+    munmap(p, round(n));
+  }
+
+ private:
+  /** Returns the mmap flag that asks the hugetlbfs pool for 2 MiB pages.
+   * Without it the pool's default size is used, and on hosts where that is
+   * 1 GiB, no 2 MiB multiple could be mapped. */
+  static int huge_page_size() {
+#if defined(MAP_HUGE_2MB)
+    return MAP_HUGE_2MB;
+#elif defined(MAP_HUGE_SHIFT)
+    return 21 << MAP_HUGE_SHIFT;
+#else
+    return 0;
+#endif
+  }
+  /** Returns n rounded up to a whole number of huge pages. */
+  static size_t round(size_t n) {
+    return (n + HUGE_PAGE - 1) & ~(size_t)(HUGE_PAGE - 1);
+  }
+  /** Maps len bytes on a huge page boundary, by mapping an extra huge page
+   * and trimming both ends. */
+  static void* map_aligned(size_t len) {
+    const auto p = mmap(nullptr, len + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(p != MAP_FAILED);
+
+    const auto base = (uintptr_t) p;
+    const auto start = (base + HUGE_PAGE - 1) & ~(uintptr_t)(HUGE_PAGE - 1);
+    if (start != base) {
+      munmap(p, start - base);
+    }
+    munmap((void*)(start + len), base + HUGE_PAGE - start);
+    return (void*) start;
+  }
+  /** Sets the NUMA policy of a block before any of its pages are touched.
+   * This calls mbind directly rather than through libnuma, and ignores
+   * failures, which are what kernels without NUMA support and nodes that
+   * don't exist produce. */
+  static void place(void* p, size_t len, NumaPolicy policy, unsigned node) {
+    if (policy == NumaPolicy::DEFAULT) {
+      return;
+    }
+    const size_t bits = 8 * sizeof(unsigned long);
+    unsigned long mask = 0;
+    if (policy == NumaPolicy::BIND) {
+      if (node >= bits) {
+        return;
+      }
+      mask = 1ul << node;
+    } else {
+      mask = ~0ul;
+    }
+    const auto mode = policy == NumaPolicy::BIND ? MPOL_BIND : MPOL_INTERLEAVE;
+    syscall(SYS_mbind, p, len, mode, &mask, bits, 0);
+  }
+};
+
+/* A version of Aligned that maps blocks of 2 MiB or more with HugeMapping,
+ * backing them with huge pages of kind H, placed on NUMA nodes by policy P
+ * (Node names the node for NumaPolicy::BIND). Smaller blocks come from
+ * posix_memalign, just as they do for Aligned. It has no state, so a
+ * container's type says how its memory is backed; for example,
+ * BasicBitVector<HugeAligned<uint64_t, 32>> is a BitVector that uses
+ * transparent huge pages once it grows past 16 million bits. */
+template <typename T, size_t N = 16, HugePages H = HugePages::TRANSPARENT,
+          NumaPolicy P = NumaPolicy::DEFAULT, unsigned Node = 0>
+class HugeAligned {
+ public:
+  static_assert((N & (N - 1)) == 0, "Alignment must be a power of two");
+
+  typedef T value_type;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+
+  template <typename T2>
+  struct rebind {
+    typedef HugeAligned<T2, N, H, P, Node> other;
+  };
+
+  HugeAligned() { }
+  template <typename T2>
+  HugeAligned(const HugeAligned<T2, N, H, P, Node>&) { }
+
+  /** Returns space for n values. */
+  pointer allocate(size_type n) {
+    const auto bytes = n * sizeof(T);
+    if (bytes >= HugeMapping::HUGE_PAGE) {
+      return (pointer) HugeMapping::map(bytes, H, P, Node);
+    }
+    void* p = nullptr;
+    const auto res = posix_memalign(&p, N > sizeof(void*) ? N : sizeof(void*), bytes);
+    assert(res == 0);
+    (void) res;
+    return (pointer) p;
+  }
+  /** Frees the space for n values at p. */
+  void deallocate(pointer p, size_type n) {
+    const auto bytes = n * sizeof(T);
+    if (bytes >= HugeMapping::HUGE_PAGE) {
+      HugeMapping::unmap(p, bytes);
+    } else {
+      free(p);
+    }
+  }
+  /** Returns the largest number of values that can be allocated. */
+  size_type max_size() const {
+    return std::numeric_limits<size_type>::max() / sizeof(T);
+  }
+
+  template <typename T2>
+  bool operator==(const HugeAligned<T2, N, H, P, Node>&) const {
+    return true;
+  }
+  template <typename T2>
+  bool operator!=(const HugeAligned<T2, N, H, P, Node>&) const {
+    return false;
+  }
+};
+
+template <typename T, size_t N, HugePages H, NumaPolicy P, unsigned Node>
+struct allocator_alignment<HugeAligned<T, N, H, P, Node>> :
+  public std::integral_constant<size_t, (N > alignof(T) ? N : alignof(T))> { };
+
+} // namespace cpputil
+
+#endif
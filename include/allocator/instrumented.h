@@ -0,0 +1,334 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_ALLOCATOR_INSTRUMENTED_H
+#define CPPUTIL_INCLUDE_ALLOCATOR_INSTRUMENTED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "include/allocator/alignment.h"
+#include "include/bits/bit_manip.h"
+#include "include/serialize/text_writer.h"
+
+namespace cpputil {
+
+/* A snapshot of the allocations made under one tag. Bucket b of the size
+ * histogram counts the allocations of more than 2^(b-1) and at most 2^b bytes;
+ * trailing empty buckets are left off. */
+struct AllocStats {
+  std::string tag;
+  uint64_t allocs;
+  uint64_t frees;
+  uint64_t bytes;
+  uint64_t live;
+  uint64_t peak;
+  std::vector<uint64_t> sizes;
+};
+
+/* The statistics for one tag. Each thread counts into its own set of
+ * counters, which only it writes, so counting takes no locks and no atomic
+ * read-modify-writes. Live bytes are the exception: they have to be summed
+ * across threads to track a peak, so each thread holds back changes of less
+ * than FLUSH_BYTES and adds them to a shared total in bulk. The peak can be
+ * low by up to FLUSH_BYTES per thread. Snapshots take a lock, as do the first
+ * allocation on each thread and thread exit. */
+class AllocSite {
+ public:
+  enum : size_t {
+    BUCKETS = 40,
+    FLUSH_BYTES = 1 << 12
+  };
+
+  class Local;
+
+  /** Returns the site for Tag, whose name is Tag::name(). */
+  template <typename Tag>
+  static AllocSite& get() {
+    static AllocSite s(Tag::name());
+    return s;
+  }
+  /** Returns the calling thread's counters for Tag, or nullptr once they are
+   * gone, which only happens while static objects are destroyed. */
+  template <typename Tag>
+  static Local* local() {
+    static thread_local bool gone = false;
+    static thread_local Local l(get<Tag>(), gone);
+    return gone ? nullptr : &l;
+  }
+
+  /** Returns a snapshot of this site. */
+  AllocStats stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Totals t = retired_;
+    int64_t pending = 0;
+    for (const auto c : threads_) {
+      t.add(*c);
+      pending += c->pending.load(std::memory_order_relaxed);
+    }
+    const auto live = std::max<int64_t>(live_.load() + pending, 0);
+
+    AllocStats res {name_, t.allocs, t.frees, t.bytes, (uint64_t) live,
+                    std::max<uint64_t>(peak_.load(), live), {}};
+    size_t last = BUCKETS;
+    while (last > 0 && t.sizes[last - 1] == 0) {
+      --last;
+    }
+    res.sizes.assign(t.sizes, t.sizes + last);
+    return res;
+  }
+  /** Returns a snapshot of every site, in the order that they were first
+   * used. */
+  static std::vector<AllocStats> report() {
+    std::vector<AllocStats> res;
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    for (const auto s : registry()) {
+      res.push_back(s->stats());
+    }
+    return res;
+  }
+
+ private:
+  /** One thread's counters. */
+  struct Counters {
+    std::atomic<uint64_t> allocs;
+    std::atomic<uint64_t> frees;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> sizes[BUCKETS];
+    std::atomic<int64_t> pending;
+
+    Counters() : allocs(0), frees(0), bytes(0), pending(0) {
+      for (auto& s : sizes) {
+        s.store(0, std::memory_order_relaxed);
+      }
+    }
+  };
+  /** The sum of some counters. */
+  struct Totals {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t bytes;
+    uint64_t sizes[BUCKETS];
+
+    Totals() : allocs(0), frees(0), bytes(0), sizes() { }
+    void add(const Counters& c) {
+      allocs += c.allocs.load(std::memory_order_relaxed);
+      frees += c.frees.load(std::memory_order_relaxed);
+      bytes += c.bytes.load(std::memory_order_relaxed);
+      for (size_t i = 0; i < BUCKETS; ++i) {
+        sizes[i] += c.sizes[i].load(std::memory_order_relaxed);
+      }
+    }
+  };
+
+  std::string name_;
+  std::mutex mutex_;
+  std::vector<Counters*> threads_;
+  Totals retired_;
+  std::atomic<int64_t> live_;
+  std::atomic<int64_t> peak_;
+
+  /** Creates and registers a site. */
+  explicit AllocSite(const std::string& name) : name_(name), live_(0), peak_(0) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    registry().push_back(this);
+  }
+
+  /** Returns the bucket for an allocation of n bytes. */
+  static size_t bucket(size_t n) {
+    const auto b = n <= 1 ? 0 : 64 - BitManip<uint64_t>::nlz(n - 1);
+    return std::min(b, (size_t) BUCKETS - 1);
+  }
+
+  /** Starts summing a thread's counters. */
+  void attach(Counters* c) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_.push_back(c);
+  }
+  /** Stops summing a thread's counters, and keeps their totals. */
+  void detach(Counters* c) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.add(*c);
+    live_ += c->pending.load(std::memory_order_relaxed);
+    threads_.erase(std::find(threads_.begin(), threads_.end(), c));
+  }
+  /** Adds to the shared live bytes, and raises the peak to match. */
+  void add_live(int64_t n) {
+    const auto live = live_.fetch_add(n, std::memory_order_relaxed) + n;
+    auto peak = peak_.load(std::memory_order_relaxed);
+    while (live > peak && !peak_.compare_exchange_weak(peak, live)) { }
+  }
+
+  /** Every site, in the order that they were first used. */
+  static std::vector<AllocSite*>& registry() {
+    static std::vector<AllocSite*> sites;
+    return sites;
+  }
+  /** Guards the registry. */
+  static std::mutex& registry_mutex() {
+    static std::mutex m;
+    return m;
+  }
+};
+
+/* Counts allocations under a tag on the calling thread. */
+class AllocSite::Local {
+ public:
+  /** Attaches this thread's counters to site; gone is set once they are
+   * detached again. */
+  Local(AllocSite& site, bool& gone) : site_(site), gone_(gone) {
+    site_.attach(&c_);
+  }
+  /** Folds this thread's counters into site. */
+  ~Local() {
+    site_.detach(&c_);
+    gone_ = true;
+  }
+
+  Local(const Local&) = delete;
+  Local& operator=(const Local&) = delete;
+
+  /** Counts an allocation of n bytes. */
+  void allocate(size_t n) {
+    bump(c_.allocs, 1);
+    bump(c_.bytes, n);
+    bump(c_.sizes[bucket(n)], 1);
+    add_live(n);
+  }
+  /** Counts a deallocation of n bytes. */
+  void deallocate(size_t n) {
+    bump(c_.frees, 1);
+    add_live(-(int64_t) n);
+  }
+
+ private:
+  AllocSite& site_;
+  bool& gone_;
+  Counters c_;
+
+  /** Adds to a counter that no other thread writes. */
+  static void bump(std::atomic<uint64_t>& a, uint64_t n) {
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+  /** Holds back a change in live bytes, until there's enough to share. */
+  void add_live(int64_t n) {
+    const auto p = c_.pending.load(std::memory_order_relaxed) + n;
+    if (p >= (int64_t) FLUSH_BYTES || p <= -(int64_t) FLUSH_BYTES) {
+      site_.add_live(p);
+      c_.pending.store(0, std::memory_order_relaxed);
+    } else {
+      c_.pending.store(p, std::memory_order_relaxed);
+    }
+  }
+};
+
+/* An allocator adaptor that counts every allocation that A makes under Tag,
+ * which is any type with a static name() that returns a string. Rebinding
+ * keeps the tag, so every node and bucket array of a container is counted
+ * against it. For example,
+ *
+ *   struct Names { static const char* name() { return "names"; } };
+ *   Interner<std::string, std::unordered_set<std::string,
+ *     std::hash<std::string>, std::equal_to<std::string>,
+ *     Instrumented<std::allocator<std::string>, Names>>> names;
+ *
+ * counts every allocation that names makes, and AllocSite::report() returns
+ * the statistics for every tag in use. */
+template <typename A, typename Tag>
+class Instrumented {
+  typedef std::allocator_traits<A> traits;
+
+ public:
+  typedef typename traits::value_type value_type;
+  typedef typename traits::size_type size_type;
+  typedef typename traits::difference_type difference_type;
+  typedef typename traits::pointer pointer;
+  typedef typename traits::const_pointer const_pointer;
+  typedef value_type& reference;
+  typedef const value_type& const_reference;
+
+  template <typename T2>
+  struct rebind {
+    typedef Instrumented<typename traits::template rebind_alloc<T2>, Tag> other;
+  };
+
+  Instrumented() : alloc_() { }
+  /** Counts the allocations that a makes. */
+  explicit Instrumented(const A& a) : alloc_(a) { }
+  /** Rebinding constructor. */
+  template <typename A2>
+  Instrumented(const Instrumented<A2, Tag>& rhs) : alloc_(rhs.inner()) { }
+
+  /** Returns space for n values. */
+  pointer allocate(size_type n) {
+    if (const auto l = AllocSite::local<Tag>()) {
+      l->allocate(n * sizeof(value_type));
+    }
+    return traits::allocate(alloc_, n);
+  }
+  /** Frees the space for n values at p. */
+  void deallocate(pointer p, size_type n) {
+    if (const auto l = AllocSite::local<Tag>()) {
+      l->deallocate(n * sizeof(value_type));
+    }
+    traits::deallocate(alloc_, p, n);
+  }
+  /** Returns the largest number of values that can be allocated. */
+  size_type max_size() const {
+    return traits::max_size(alloc_);
+  }
+
+  /** Returns the allocator that does the work. */
+  const A& inner() const {
+    return alloc_;
+  }
+
+  template <typename A2>
+  bool operator==(const Instrumented<A2, Tag>& rhs) const {
+    return alloc_ == rhs.inner();
+  }
+  template <typename A2>
+  bool operator!=(const Instrumented<A2, Tag>& rhs) const {
+    return !(*this == rhs);
+  }
+
+ private:
+  A alloc_;
+};
+
+template <typename A, typename Tag>
+struct allocator_alignment<Instrumented<A, Tag>> :
+  public std::integral_constant<size_t, allocator_alignment<A>::value> { };
+
+/** Writes a snapshot as { tag allocs frees bytes live peak { sizes } }. */
+template <typename Style>
+struct TextWriter<AllocStats, Style> {
+  void operator()(std::ostream& os, const AllocStats& s) const {
+    const auto t = std::make_tuple(s.tag, s.allocs, s.frees, s.bytes, s.live, s.peak, s.sizes);
+    TextWriter<decltype(t), Style>()(os, t);
+  }
+};
+
+} // namespace cpputil
+
+#endif
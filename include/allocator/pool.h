@@ -0,0 +1,343 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_ALLOCATOR_POOL_H
+#define CPPUTIL_INCLUDE_ALLOCATOR_POOL_H
+
+#include <cassert>
+#include <cstdlib>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#include "include/allocator/alignment.h"
+
+namespace cpputil {
+
+/* Fixed-size blocks for small allocations. Requests are rounded up to one of
+ * sixteen size classes, 16 to 256 bytes apart by 16. Each thread keeps a free
+ * list per class and serves most requests from it without synchronization.
+ * Blocks move between threads in batches through a lock-free depot per
+ * class: a thread whose list grows past two batches pushes one, and a thread
+ * whose list runs dry pops one before it carves new blocks out of a slab.
+ * Freeing a block on a thread other than the one that allocated it is just
+ * another push onto that thread's list.
+ *
+ * A block of size s is aligned to the largest power of two that divides s,
+ * up to 64 bytes, so rounding a request to its alignment is enough to honor
+ * it. Larger or more strictly aligned requests go to posix_memalign. Slabs
+ * are never returned to the system; the pool only grows to the peak number of
+ * live blocks. */
+class SizeClassPool {
+ public:
+  enum : size_t {
+    QUANTUM = 16,
+    MAX_SIZE = 256,
+    CLASSES = MAX_SIZE / QUANTUM,
+    BATCH_BYTES = 4096,
+    SLAB_BYTES = 1 << 16,
+    SLAB_ALIGN = 64
+  };
+
+  /** Returns n bytes aligned to align, which must be a power of two. */
+  static void* allocate(size_t n, size_t align) {
+    const auto c = size_class(n, align);
+    if (c == CLASSES) {
+      void* p = nullptr;
+      const auto res = posix_memalign(&p, std::max(align, sizeof(void*)), n);
+      assert(res == 0);
+      (void) res;
+      return p;
+    }
+    if (cache_gone()) {
+      return allocate_uncached(c);
+    }
+
+    auto& l = cache().lists[c];
+    if (l.head == nullptr) {
+      refill(l, c);
+    }
+    const auto b = l.head;
+    l.head = b->next;
+    --l.count;
+    return b;
+  }
+  /** Frees n bytes at p that were allocated with the same alignment. */
+  static void deallocate(void* p, size_t n, size_t align) {
+    const auto c = size_class(n, align);
+    if (c == CLASSES) {
+      free(p);
+      return;
+    }
+    const auto b = (Block*) p;
+    if (cache_gone()) {
+      b->next = nullptr;
+      push(c, b);
+      return;
+    }
+
+    auto& l = cache().lists[c];
+    b->next = l.head;
+    l.head = b;
+    if (++l.count >= 2 * batch(c)) {
+      flush(l, c, batch(c));
+    }
+  }
+
+  /** Returns the number of bytes that slabs have taken from the system. */
+  static size_t slab_bytes() {
+    return slab_counter().load(std::memory_order_relaxed);
+  }
+
+ private:
+  /** A free block. The head of a batch in the depot also links to the next
+   * batch. */
+  struct Block {
+    Block* next;
+    Block* batch;
+  };
+  /** A thread's blocks of one size class, and the slab it carves from. */
+  struct List {
+    Block* head;
+    size_t count;
+    char* carve;
+    char* end;
+  };
+  /** A thread's lists, which go to the depot when the thread exits. */
+  struct Cache {
+    List lists[CLASSES];
+
+    Cache() {
+      for (auto& l : lists) {
+        l = {nullptr, 0, nullptr, nullptr};
+      }
+    }
+    ~Cache() {
+      for (size_t c = 0; c < CLASSES; ++c) {
+        auto& l = lists[c];
+        while (l.carve != l.end) {
+          const auto b = (Block*) l.carve;
+          l.carve += block_size(c);
+          b->next = l.head;
+          l.head = b;
+        }
+        if (l.head != nullptr) {
+          push(c, l.head);
+        }
+      }
+      cache_gone() = true;
+    }
+  };
+
+  /** Returns the class for n bytes aligned to align, or CLASSES if the
+   * request is too large for any class. */
+  static size_t size_class(size_t n, size_t align) {
+    assert((align & (align - 1)) == 0);
+    if (align > SLAB_ALIGN) {
+      return CLASSES;
+    }
+    const auto a = align > QUANTUM ? align : (size_t) QUANTUM;
+    const auto s = n == 0 ? a : (n + a - 1) & ~(a - 1);
+    return s > MAX_SIZE ? CLASSES : s / QUANTUM - 1;
+  }
+  /** Returns the size of the blocks in a class. */
+  static size_t block_size(size_t c) {
+    return (c + 1) * QUANTUM;
+  }
+  /** Returns the number of blocks in a batch of a class. */
+  static size_t batch(size_t c) {
+    return BATCH_BYTES / block_size(c);
+  }
+
+  /** Pops a batch from the depot, or carves one out of a slab. */
+  static void refill(List& l, size_t c) {
+    if ((l.head = pop(c)) != nullptr) {
+      l.count = 0;
+      for (auto b = l.head; b != nullptr; b = b->next) {
+        ++l.count;
+      }
+      return;
+    }
+    const auto s = block_size(c);
+    for (size_t i = 0, ie = batch(c); i < ie; ++i) {
+      if (l.carve == l.end) {
+        l.carve = new_slab();
+        l.end = l.carve + SLAB_BYTES / s * s;
+      }
+      const auto b = (Block*) l.carve;
+      l.carve += s;
+      b->next = l.head;
+      l.head = b;
+      ++l.count;
+    }
+  }
+  /** Moves the first n blocks of a list to the depot. */
+  static void flush(List& l, size_t c, size_t n) {
+    const auto first = l.head;
+    auto last = first;
+    for (size_t i = 1; i < n; ++i) {
+      last = last->next;
+    }
+    l.head = last->next;
+    l.count -= n;
+    last->next = nullptr;
+    push(c, first);
+  }
+  /** Returns one block without a thread cache, which only happens while
+   * static objects are destroyed after the thread's cache is gone. */
+  static void* allocate_uncached(size_t c) {
+    const auto b = pop(c);
+    if (b == nullptr) {
+      void* p = nullptr;
+      const auto res = posix_memalign(&p, SLAB_ALIGN, block_size(c));
+      assert(res == 0);
+      (void) res;
+      return p;
+    }
+    if (b->next != nullptr) {
+      push(c, b->next);
+    }
+    return b;
+  }
+
+  /** The top of each depot, as a pointer in the low 48 bits and a count of
+   * pushes in the high 16, which keeps a pop from succeeding after the top
+   * was popped and pushed back in between (the ABA problem). A popped batch
+   * may be reused while another thread still reads its link; slabs are never
+   * freed, so that read is harmless and the count makes its pop fail. */
+  static std::atomic<uint64_t>* depot() {
+    static std::atomic<uint64_t> d[CLASSES];
+    return d;
+  }
+  /** Pushes a batch onto the depot of a class. */
+  static void push(size_t c, Block* b) {
+    assert(((uintptr_t) b >> 48) == 0);
+    auto& top = depot()[c];
+    auto old = top.load(std::memory_order_relaxed);
+    uint64_t val = 0;
+    do {
+      __atomic_store_n(&b->batch, (Block*)(old & PTR_MASK), __ATOMIC_RELAXED);
+      val = (uint64_t) b | ((old & ~PTR_MASK) + (0x1ull << 48));
+    } while (!top.compare_exchange_weak(old, val, std::memory_order_release,
+                                        std::memory_order_relaxed));
+  }
+  /** Pops a batch from the depot of a class, or returns nullptr. */
+  static Block* pop(size_t c) {
+    auto& top = depot()[c];
+    auto old = top.load(std::memory_order_acquire);
+    while ((old & PTR_MASK) != 0) {
+      const auto b = (Block*)(old & PTR_MASK);
+      const auto next = __atomic_load_n(&b->batch, __ATOMIC_RELAXED);
+      const auto val = (uint64_t) next | (old & ~PTR_MASK);
+      if (top.compare_exchange_weak(old, val, std::memory_order_acquire,
+                                    std::memory_order_acquire)) {
+        return b;
+      }
+    }
+    return nullptr;
+  }
+
+  /** Returns a new slab. */
+  static char* new_slab() {
+    void* p = nullptr;
+    const auto res = posix_memalign(&p, SLAB_ALIGN, SLAB_BYTES);
+    assert(res == 0);
+    (void) res;
+    slab_counter().fetch_add(SLAB_BYTES, std::memory_order_relaxed);
+    return (char*) p;
+  }
+  /** Counts the bytes held in slabs. */
+  static std::atomic<size_t>& slab_counter() {
+    static std::atomic<size_t> n(0);
+    return n;
+  }
+
+  /** Returns this thread's cache. */
+  static Cache& cache() {
+    static thread_local Cache c;
+    return c;
+  }
+  /** Set once this thread's cache has been destroyed. */
+  static bool& cache_gone() {
+    static thread_local bool gone = false;
+    return gone;
+  }
+
+  static constexpr uint64_t PTR_MASK = (0x1ull << 48) - 1;
+};
+
+/* An allocator that takes small blocks from the SizeClassPool, aligned to N
+ * bytes. It has no state, so it can stand in for Aligned anywhere, and it
+ * suits the node-based containers inside Interner, Bijection and Tokenizer,
+ * which allocate one small node at a time. */
+template <typename T, size_t N = 16>
+class Pooled {
+ public:
+  static_assert((N & (N - 1)) == 0, "Alignment must be a power of two");
+
+  typedef T value_type;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+
+  template <typename T2>
+  struct rebind {
+    typedef Pooled<T2, N> other;
+  };
+
+  Pooled() { }
+  template <typename T2>
+  Pooled(const Pooled<T2, N>&) { }
+
+  /** Returns space for n values. */
+  pointer allocate(size_type n) {
+    return (pointer) SizeClassPool::allocate(n * sizeof(T), alignment());
+  }
+  /** Returns the space for n values to the pool. */
+  void deallocate(pointer p, size_type n) {
+    SizeClassPool::deallocate(p, n * sizeof(T), alignment());
+  }
+  /** Returns the largest number of values that can be allocated. */
+  size_type max_size() const {
+    return std::numeric_limits<size_type>::max() / sizeof(T);
+  }
+
+  template <typename T2>
+  bool operator==(const Pooled<T2, N>&) const {
+    return true;
+  }
+  template <typename T2>
+  bool operator!=(const Pooled<T2, N>&) const {
+    return false;
+  }
+
+ private:
+  static constexpr size_t alignment() {
+    return N > alignof(T) ? N : alignof(T);
+  }
+};
+
+template <typename T, size_t N>
+struct allocator_alignment<Pooled<T, N>> :
+  public std::integral_constant<size_t, (N > alignof(T) ? N : alignof(T))> { };
+
+} // namespace cpputil
+
+#endif
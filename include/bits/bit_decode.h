@@ -0,0 +1,257 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_BITS_BIT_DECODE_H
+#define CPPUTIL_INCLUDE_BITS_BIT_DECODE_H
+
+#include <immintrin.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "include/bits/bit_manip.h"
+#include "include/system/cpu_features.h"
+
+namespace cpputil {
+
+/** Converts arrays of quads into the indices of their set bits. Every kernel
+ * produces the same result; decode() forwards to the fastest one the host
+ * supports. The vector kernels write whole vectors at a time, and so may
+ * write up to SLACK entries past the last index that they return.
+ *
+ * The same is done for arrays of bytes, words, doubles and quads whose
+ * nonzero elements are wanted rather than their set bits. Those routines
+ * test 32 bytes at a time when compiled with avx2. */
+class BitDecode {
+ public:
+  typedef size_t (*kernel_type)(const uint64_t*, size_t, size_t, uint32_t*);
+
+  enum : size_t {
+    /** The number of entries a kernel may write past the end of its output. */
+    SLACK = 16,
+    /** 256-bit blocks with fewer set bits than this are cheaper to decode one
+     * bit at a time than with a vector kernel. */
+    SPARSE = 32
+  };
+
+  /** Writes base plus the index of every set bit in the n quads starting at
+   * p to out, and returns the number of indices written. */
+  static size_t decode(const uint64_t* p, size_t n, size_t base, uint32_t* out) {
+    return kernel()(p, n, base, out);
+  }
+
+  /** Returns the kernel used by decode(). */
+  static kernel_type kernel() {
+    static const kernel_type k = has_avx512() ? avx512 : has_avx2() ? avx2 : scalar;
+    return k;
+  }
+
+  /** True if the host can run the avx2 kernel. */
+  static bool has_avx2() {
+    return CpuFeatures::has_avx2();
+  }
+  /** True if the host can run the avx512 kernel. */
+  static bool has_avx512() {
+    return CpuFeatures::has_avx512();
+  }
+
+  /** One bit at a time; never writes past the end of its output. */
+  static size_t scalar(const uint64_t* p, size_t n, size_t base, uint32_t* out) {
+    auto o = out;
+    for (size_t i = 0; i < n; ++i) {
+      for (auto w = p[i]; w; BitManip<uint64_t>::unset_rightmost(w)) {
+        *o++ = base + 64 * i + BitManip<uint64_t>::ntz(w);
+      }
+    }
+    return o - out;
+  }
+
+  /** Skips empty 256-bit blocks, and expands every byte of the others through
+   * a table that holds the positions of its set bits. Sparse blocks are
+   * decoded one bit at a time instead. */
+  __attribute__((target("avx2,bmi,popcnt")))
+  static size_t avx2(const uint64_t* p, size_t n, size_t base, uint32_t* out) {
+    const auto& t = table();
+    const auto eight = _mm256_set1_epi32(8);
+    auto o = out;
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      const auto x = _mm256_loadu_si256((const __m256i*)(p + i));
+      if (_mm256_testz_si256(x, x)) {
+        continue;
+      }
+      if (is_sparse(p + i)) {
+        o = sparse(p + i, base + 64 * i, o);
+        continue;
+      }
+
+      auto b = _mm256_set1_epi32(base + 64 * i);
+      for (size_t j = 0; j < 4; ++j) {
+        auto w = p[i + j];
+        for (size_t k = 0; k < 8; ++k, w >>= 8) {
+          const auto idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) t.idx[w & 0xff]));
+          _mm256_storeu_si256((__m256i*) o, _mm256_add_epi32(idx, b));
+          o += t.count[w & 0xff];
+          b = _mm256_add_epi32(b, eight);
+        }
+      }
+    }
+
+    return (o - out) + scalar(p + i, n - i, base + 64 * i, o);
+  }
+
+  /** Skips empty 256-bit blocks, and uses VPCOMPRESSD to pack the indices of
+   * the set bits of every 16-bit chunk of the others. Sparse blocks are
+   * decoded one bit at a time instead. */
+  __attribute__((target("avx512f,bmi,popcnt")))
+  static size_t avx512(const uint64_t* p, size_t n, size_t base, uint32_t* out) {
+    const auto sixteen = _mm512_set1_epi32(16);
+    const auto lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    auto o = out;
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      const auto x = _mm256_loadu_si256((const __m256i*)(p + i));
+      if (_mm256_testz_si256(x, x)) {
+        continue;
+      }
+      if (is_sparse(p + i)) {
+        o = sparse(p + i, base + 64 * i, o);
+        continue;
+      }
+
+      auto idx = _mm512_add_epi32(lanes, _mm512_set1_epi32(base + 64 * i));
+      for (size_t j = 0; j < 4; ++j) {
+        auto w = p[i + j];
+        for (size_t k = 0; k < 4; ++k, w >>= 16) {
+          _mm512_storeu_si512((void*) o, _mm512_maskz_compress_epi32(w & 0xffff, idx));
+          o += __builtin_popcountll(w & 0xffff);
+          idx = _mm512_add_epi32(idx, sixteen);
+        }
+      }
+    }
+
+    return (o - out) + scalar(p + i, n - i, base + 64 * i, o);
+  }
+
+  /** Returns the first nonzero element in [p, end), or end if there is none. */
+  template <typename S>
+  static const S* next_nonzero(const S* p, const S* end) {
+#if defined(__AVX2__) && defined(__AVX__)
+    for (; end - p >= (ptrdiff_t)(32 / sizeof(S)); p += 32 / sizeof(S)) {
+      const auto m = nonzero_lanes(p);
+      if (m) {
+        return p + BitManip<uint64_t>::ntz(m) / sizeof(S);
+      }
+    }
+#endif
+    for (; p != end && *p == 0; ++p);
+    return p;
+  }
+
+  /** Writes the index of every nonzero element among the n starting at p to
+   * out, and returns the number of indices written. Never writes past the
+   * end of its output. */
+  template <typename S>
+  static size_t decode_nonzero(const S* p, size_t n, uint32_t* out) {
+    auto o = out;
+    size_t i = 0;
+
+#if defined(__AVX2__) && defined(__AVX__)
+    for (; i + 32 / sizeof(S) <= n; i += 32 / sizeof(S)) {
+      for (auto m = nonzero_lanes(p + i); m; m &= m - 1) {
+        *o++ = i + BitManip<uint64_t>::ntz(m) / sizeof(S);
+      }
+    }
+#endif
+    for (; i < n; ++i) {
+      if (p[i]) {
+        *o++ = i;
+      }
+    }
+    return o - out;
+  }
+
+ private:
+  /** Positions of the set bits of every byte, and the number of them. */
+  struct Table {
+    Table() {
+      for (size_t b = 0; b < 256; ++b) {
+        count[b] = 0;
+        for (size_t j = 0; j < 8; ++j) {
+          idx[b][j] = 0;
+          if (b & (0x1u << j)) {
+            idx[b][count[b]++] = j;
+          }
+        }
+      }
+    }
+
+    uint8_t idx[256][8];
+    uint8_t count[256];
+  };
+
+#if defined(__AVX2__) && defined(__AVX__)
+  /** These return a mask of the nonzero elements among the 32 bytes at p.
+   * Each element is represented by the bit of its lowest byte. */
+  static uint32_t nonzero_lanes(const uint8_t* p) {
+    const auto x = _mm256_loadu_si256((const __m256i*) p);
+    return ~(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_setzero_si256()));
+  }
+  static uint32_t nonzero_lanes(const uint16_t* p) {
+    const auto x = _mm256_loadu_si256((const __m256i*) p);
+    return ~(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi16(x, _mm256_setzero_si256())) &
+           0x55555555;
+  }
+  static uint32_t nonzero_lanes(const uint32_t* p) {
+    const auto x = _mm256_loadu_si256((const __m256i*) p);
+    return ~(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi32(x, _mm256_setzero_si256())) &
+           0x11111111;
+  }
+  static uint32_t nonzero_lanes(const uint64_t* p) {
+    const auto x = _mm256_loadu_si256((const __m256i*) p);
+    return ~(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi64(x, _mm256_setzero_si256())) &
+           0x01010101;
+  }
+#endif
+
+  /** Returns the lookup table used by the avx2 kernel. */
+  static const Table& table() {
+    static const Table t;
+    return t;
+  }
+
+  /** True if the four quads starting at p have fewer than SPARSE set bits.
+   * Callers must be compiled for popcnt. */
+  __attribute__((always_inline, target("popcnt")))
+  static inline bool is_sparse(const uint64_t* p) {
+    return (size_t)(__builtin_popcountll(p[0]) + __builtin_popcountll(p[1]) +
+                    __builtin_popcountll(p[2]) + __builtin_popcountll(p[3])) < SPARSE;
+  }
+  /** Decodes the four quads starting at p one bit at a time. Callers must be
+   * compiled for bmi. */
+  __attribute__((always_inline, target("bmi")))
+  static inline uint32_t* sparse(const uint64_t* p, size_t base, uint32_t* out) {
+    for (size_t i = 0; i < 4; ++i) {
+      for (auto w = p[i]; w; w &= w - 1) {
+        *out++ = base + 64 * i + __builtin_ctzll(w);
+      }
+    }
+    return out;
+  }
+};
+
+} // namespace cpputil
+
+#endif
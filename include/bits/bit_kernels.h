@@ -0,0 +1,616 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_BITS_BIT_KERNELS_H
+#define CPPUTIL_INCLUDE_BITS_BIT_KERNELS_H
+
+#include <cassert>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <immintrin.h>
+
+#include "include/bits/pop_count.h"
+#include "include/system/cpu_features.h"
+
+namespace cpputil {
+
+/* Bulk bit-wise operations on arrays of quads, in sse2, avx2 and avx512
+ * versions. Every version produces the same result. The version is picked
+ * once, from CpuFeatures, the first time any operation is called; after that
+ * a call costs one indirect branch. Arrays must be 32-byte aligned. */
+class BitKernels {
+ public:
+  typedef void (*binary_type)(uint64_t*, const uint64_t*, size_t);
+  typedef bool (*equal_type)(const uint64_t*, const uint64_t*, size_t);
+  typedef void (*not_type)(uint64_t*, const uint64_t*, size_t, bool);
+  typedef uint64_t (*hash_type)(const uint64_t*, size_t, uint64_t);
+  typedef size_t (*count_type)(const uint64_t*, const uint64_t*, size_t);
+  typedef bool (*any_type)(const uint64_t*, const uint64_t*, size_t);
+
+  /** One version of every operation. */
+  struct Table {
+    binary_type and_into;
+    binary_type or_into;
+    binary_type xor_into;
+    equal_type equal;
+    not_type not_into;
+    hash_type hash;
+    count_type and_count;
+    count_type or_count;
+    count_type xor_count;
+    count_type andnot_count;
+    any_type and_any;
+    any_type or_any;
+    any_type xor_any;
+    any_type andnot_any;
+  };
+
+  /** Ands the n quads at src into the n quads at dst. */
+  static void and_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    table().and_into(dst, src, n);
+  }
+  /** Ors the n quads at src into the n quads at dst. */
+  static void or_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    table().or_into(dst, src, n);
+  }
+  /** Xors the n quads at src into the n quads at dst. */
+  static void xor_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    table().xor_into(dst, src, n);
+  }
+  /** Returns true if the n quads at p and q are the same. */
+  static bool equal(const uint64_t* p, const uint64_t* q, size_t n) {
+    return table().equal(p, q, n);
+  }
+  /** Writes the complement of the n quads at src to dst, which may be src.
+   * Streaming stores go around the cache; see StoreMode. */
+  static void not_into(uint64_t* dst, const uint64_t* src, size_t n, bool stream) {
+    table().not_into(dst, src, n, stream);
+  }
+  /** Returns a hash of the n quads at p, which need not be aligned. Stripes of
+   * eight quads go into eight multiply-accumulate lanes, which are mixed
+   * together with seed at the end. */
+  static uint64_t hash(const uint64_t* p, size_t n, uint64_t seed) {
+    return table().hash(p, n, seed);
+  }
+
+  /** These return the number of set bits in the n quads at p and, or, xor
+   * and and-not (p & ~q) the n quads at q, without writing the result. */
+  static size_t and_count(const uint64_t* p, const uint64_t* q, size_t n) {
+    return table().and_count(p, q, n);
+  }
+  static size_t or_count(const uint64_t* p, const uint64_t* q, size_t n) {
+    return table().or_count(p, q, n);
+  }
+  static size_t xor_count(const uint64_t* p, const uint64_t* q, size_t n) {
+    return table().xor_count(p, q, n);
+  }
+  static size_t andnot_count(const uint64_t* p, const uint64_t* q, size_t n) {
+    return table().andnot_count(p, q, n);
+  }
+  /** These return true if the same combinations have any set bits. They stop
+   * reading as soon as one is found. */
+  static bool and_any(const uint64_t* p, const uint64_t* q, size_t n) {
+    return table().and_any(p, q, n);
+  }
+  static bool or_any(const uint64_t* p, const uint64_t* q, size_t n) {
+    return table().or_any(p, q, n);
+  }
+  static bool xor_any(const uint64_t* p, const uint64_t* q, size_t n) {
+    return table().xor_any(p, q, n);
+  }
+  static bool andnot_any(const uint64_t* p, const uint64_t* q, size_t n) {
+    return table().andnot_any(p, q, n);
+  }
+
+  /** Scrambles the bits of a quad; every input bit affects every output bit. */
+  static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+  }
+
+  /** Returns the version of every operation used on this host. */
+  static const Table& table() {
+    static const Table t = table(CpuFeatures::level());
+    return t;
+  }
+  /** Returns the version of every operation written for a level. */
+  static Table table(SimdLevel l) {
+    switch (l) {
+    case SimdLevel::AVX512:
+      return Table {binary_avx512<AND>, binary_avx512<OR>, binary_avx512<XOR>, equal_avx512,
+                    not_avx512, hash_avx512,
+                    count_avx512<AND>, count_avx512<OR>, count_avx512<XOR>, count_avx512<ANDNOT>,
+                    any_avx512<AND>, any_avx512<OR>, any_avx512<XOR>, any_avx512<ANDNOT>};
+    case SimdLevel::AVX2:
+      return Table {binary_avx2<AND>, binary_avx2<OR>, binary_avx2<XOR>, equal_avx2, not_avx2,
+                    hash_avx2,
+                    count_avx2<AND>, count_avx2<OR>, count_avx2<XOR>, count_avx2<ANDNOT>,
+                    any_avx2<AND>, any_avx2<OR>, any_avx2<XOR>, any_avx2<ANDNOT>};
+    default:
+      return Table {binary_sse2<AND>, binary_sse2<OR>, binary_sse2<XOR>, equal_sse2, not_sse2,
+                    hash_sse2,
+                    count_sse2<AND>, count_sse2<OR>, count_sse2<XOR>, count_sse2<ANDNOT>,
+                    any_sse2<AND>, any_sse2<OR>, any_sse2<XOR>, any_sse2<ANDNOT>};
+    }
+  }
+
+ private:
+  enum Op {
+    AND,
+    OR,
+    XOR,
+    ANDNOT
+  };
+
+  /** These apply an operation to a pair of quads, or of vectors of quads. */
+  template <Op O>
+  static uint64_t apply(uint64_t x, uint64_t y) {
+    return O == AND ? (x & y) : O == OR ? (x | y) : O == XOR ? (x ^ y) : (x & ~y);
+  }
+  template <Op O>
+  static __m128i apply(__m128i x, __m128i y) {
+    return O == AND ? _mm_and_si128(x, y) : O == OR ? _mm_or_si128(x, y) :
+           O == XOR ? _mm_xor_si128(x, y) : _mm_andnot_si128(y, x);
+  }
+  template <Op O>
+  __attribute__((target("avx2")))
+  static __m256i apply(__m256i x, __m256i y) {
+    return O == AND ? _mm256_and_si256(x, y) : O == OR ? _mm256_or_si256(x, y) :
+           O == XOR ? _mm256_xor_si256(x, y) : _mm256_andnot_si256(y, x);
+  }
+  /** The zero-masking form of andnot is used for the reason given at
+   * hash_avx512(). */
+  template <Op O>
+  __attribute__((target("avx512f")))
+  static __m512i apply(__m512i x, __m512i y) {
+    return O == AND ? _mm512_and_si512(x, y) : O == OR ? _mm512_or_si512(x, y) :
+           O == XOR ? _mm512_xor_si512(x, y) : _mm512_maskz_andnot_epi64(0xff, y, x);
+  }
+
+  /** Two quads at a time. */
+  template <Op O>
+  static void binary_sse2(uint64_t* dst, const uint64_t* src, size_t n) {
+    assert((uintptr_t) dst % 32 == 0);
+    assert((uintptr_t) src % 32 == 0);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+      const auto x = _mm_load_si128((const __m128i*)(dst + i));
+      const auto y = _mm_load_si128((const __m128i*)(src + i));
+      _mm_store_si128((__m128i*)(dst + i), apply<O>(x, y));
+    }
+    for (; i < n; ++i) {
+      dst[i] = apply<O>(dst[i], src[i]);
+    }
+  }
+
+  /** Four quads at a time. */
+  template <Op O>
+  __attribute__((target("avx2")))
+  static void binary_avx2(uint64_t* dst, const uint64_t* src, size_t n) {
+    assert((uintptr_t) dst % 32 == 0);
+    assert((uintptr_t) src % 32 == 0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      const auto x = _mm256_load_si256((const __m256i*)(dst + i));
+      const auto y = _mm256_load_si256((const __m256i*)(src + i));
+      _mm256_store_si256((__m256i*)(dst + i), apply<O>(x, y));
+    }
+    for (; i < n; ++i) {
+      dst[i] = apply<O>(dst[i], src[i]);
+    }
+  }
+
+  /** Eight quads at a time; the tail is handled with masked loads and stores
+   * rather than a scalar loop. */
+  template <Op O>
+  __attribute__((target("avx512f")))
+  static void binary_avx512(uint64_t* dst, const uint64_t* src, size_t n) {
+    assert((uintptr_t) dst % 32 == 0);
+    assert((uintptr_t) src % 32 == 0);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      const auto x = _mm512_loadu_si512((const void*)(dst + i));
+      const auto y = _mm512_loadu_si512((const void*)(src + i));
+      _mm512_storeu_si512((void*)(dst + i), apply<O>(x, y));
+    }
+    if (i < n) {
+      const auto m = (__mmask8)((0x1u << (n - i)) - 1);
+      const auto x = _mm512_maskz_loadu_epi64(m, (const void*)(dst + i));
+      const auto y = _mm512_maskz_loadu_epi64(m, (const void*)(src + i));
+      _mm512_mask_storeu_epi64((void*)(dst + i), m, apply<O>(x, y));
+    }
+  }
+
+  /** Two quads at a time. */
+  static bool equal_sse2(const uint64_t* p, const uint64_t* q, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+      const auto x = _mm_load_si128((const __m128i*)(p + i));
+      const auto y = _mm_load_si128((const __m128i*)(q + i));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) {
+        return false;
+      }
+    }
+    return i == n || p[i] == q[i];
+  }
+
+  /** Four quads at a time. */
+  __attribute__((target("avx2")))
+  static bool equal_avx2(const uint64_t* p, const uint64_t* q, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      const auto x = _mm256_load_si256((const __m256i*)(p + i));
+      const auto y = _mm256_load_si256((const __m256i*)(q + i));
+      const auto d = _mm256_xor_si256(x, y);
+      if (!_mm256_testz_si256(d, d)) {
+        return false;
+      }
+    }
+    for (; i < n; ++i) {
+      if (p[i] != q[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /** Eight quads at a time, with a masked tail. */
+  __attribute__((target("avx512f")))
+  static bool equal_avx512(const uint64_t* p, const uint64_t* q, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      const auto x = _mm512_loadu_si512((const void*)(p + i));
+      const auto y = _mm512_loadu_si512((const void*)(q + i));
+      if (_mm512_cmpneq_epi64_mask(x, y)) {
+        return false;
+      }
+    }
+    if (i < n) {
+      const auto m = (__mmask8)((0x1u << (n - i)) - 1);
+      const auto x = _mm512_maskz_loadu_epi64(m, (const void*)(p + i));
+      const auto y = _mm512_maskz_loadu_epi64(m, (const void*)(q + i));
+      return !_mm512_cmpneq_epi64_mask(x, y);
+    }
+    return true;
+  }
+
+  /** Two quads at a time. Bits are counted within each byte by adding up
+   * neighbouring bits, then pairs, then nibbles, as in the portable
+   * BitManip::pop_count(), and the bytes are summed with psadbw. */
+  template <Op O>
+  static size_t count_sse2(const uint64_t* p, const uint64_t* q, size_t n) {
+    assert((uintptr_t) p % 32 == 0);
+    assert((uintptr_t) q % 32 == 0);
+    auto total = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+      const auto x = _mm_load_si128((const __m128i*)(p + i));
+      const auto y = _mm_load_si128((const __m128i*)(q + i));
+      total = _mm_add_epi64(total, count_block(apply<O>(x, y)));
+    }
+    if (i < n) {
+      total = _mm_add_epi64(total, count_block(_mm_cvtsi64_si128(apply<O>(p[i], q[i]))));
+    }
+    return _mm_cvtsi128_si64(total) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total));
+  }
+  /** Returns the number of set bits in each quad of a 128-bit block. */
+  static __m128i count_block(__m128i x) {
+    const auto m1 = _mm_set1_epi8(0x55);
+    const auto m2 = _mm_set1_epi8(0x33);
+    const auto m4 = _mm_set1_epi8(0x0f);
+    x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi64(x, 1), m1));
+    x = _mm_add_epi8(_mm_and_si128(x, m2), _mm_and_si128(_mm_srli_epi64(x, 2), m2));
+    x = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi64(x, 4)), m4);
+    return _mm_sad_epu8(x, _mm_setzero_si128());
+  }
+
+  /** Four quads at a time, using PopCount's nibble lookup. */
+  template <Op O>
+  __attribute__((target("avx2,popcnt")))
+  static size_t count_avx2(const uint64_t* p, const uint64_t* q, size_t n) {
+    assert((uintptr_t) p % 32 == 0);
+    assert((uintptr_t) q % 32 == 0);
+    auto total = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      const auto x = _mm256_load_si256((const __m256i*)(p + i));
+      const auto y = _mm256_load_si256((const __m256i*)(q + i));
+      total = _mm256_add_epi64(total, PopCount::block_count(apply<O>(x, y)));
+    }
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256((__m256i*) lanes, total);
+    size_t res = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; ++i) {
+      res += __builtin_popcountll(apply<O>(p[i], q[i]));
+    }
+    return res;
+  }
+
+  /** Eight quads at a time, with a masked tail. The masked-off quads load as
+   * zeros, which every operation maps to zero. This uses the same nibble
+   * lookup as the avx2 version, since VPOPCNTQ isn't part of SimdLevel::AVX512. */
+  template <Op O>
+  __attribute__((target("avx512f,avx512bw")))
+  static size_t count_avx512(const uint64_t* p, const uint64_t* q, size_t n) {
+    auto total = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      const auto x = _mm512_loadu_si512((const void*)(p + i));
+      const auto y = _mm512_loadu_si512((const void*)(q + i));
+      total = _mm512_add_epi64(total, count_block(apply<O>(x, y)));
+    }
+    if (i < n) {
+      const auto m = (__mmask8)((0x1u << (n - i)) - 1);
+      const auto x = _mm512_maskz_loadu_epi64(m, (const void*)(p + i));
+      const auto y = _mm512_maskz_loadu_epi64(m, (const void*)(q + i));
+      total = _mm512_add_epi64(total, count_block(apply<O>(x, y)));
+    }
+    alignas(64) uint64_t lanes[8];
+    _mm512_store_si512((void*) lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+  }
+  /** Returns the number of set bits in each quad of a 512-bit block. */
+  __attribute__((target("avx512f,avx512bw")))
+  static __m512i count_block(__m512i x) {
+    const auto lookup = _mm512_set4_epi32(0x04030302, 0x03020201, 0x03020201, 0x02010100);
+    const auto low = _mm512_set1_epi8(0x0f);
+    const auto lo = _mm512_and_si512(x, low);
+    const auto hi = _mm512_and_si512(_mm512_srli_epi16(x, 4), low);
+    const auto bytes = _mm512_add_epi8(_mm512_shuffle_epi8(lookup, lo),
+                                       _mm512_shuffle_epi8(lookup, hi));
+    return _mm512_sad_epu8(bytes, _mm512_setzero_si512());
+  }
+
+  /** Two quads at a time. */
+  template <Op O>
+  static bool any_sse2(const uint64_t* p, const uint64_t* q, size_t n) {
+    assert((uintptr_t) p % 32 == 0);
+    assert((uintptr_t) q % 32 == 0);
+    const auto zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+      const auto x = _mm_load_si128((const __m128i*)(p + i));
+      const auto y = _mm_load_si128((const __m128i*)(q + i));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(apply<O>(x, y), zero)) != 0xffff) {
+        return true;
+      }
+    }
+    return i < n && apply<O>(p[i], q[i]) != 0;
+  }
+
+  /** Four quads at a time. */
+  template <Op O>
+  __attribute__((target("avx2")))
+  static bool any_avx2(const uint64_t* p, const uint64_t* q, size_t n) {
+    assert((uintptr_t) p % 32 == 0);
+    assert((uintptr_t) q % 32 == 0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      const auto x = _mm256_load_si256((const __m256i*)(p + i));
+      const auto y = _mm256_load_si256((const __m256i*)(q + i));
+      const auto z = apply<O>(x, y);
+      if (!_mm256_testz_si256(z, z)) {
+        return true;
+      }
+    }
+    for (; i < n; ++i) {
+      if (apply<O>(p[i], q[i])) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /** Eight quads at a time, with a masked tail. */
+  template <Op O>
+  __attribute__((target("avx512f")))
+  static bool any_avx512(const uint64_t* p, const uint64_t* q, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      const auto x = _mm512_loadu_si512((const void*)(p + i));
+      const auto y = _mm512_loadu_si512((const void*)(q + i));
+      const auto z = apply<O>(x, y);
+      if (_mm512_test_epi64_mask(z, z)) {
+        return true;
+      }
+    }
+    if (i < n) {
+      const auto m = (__mmask8)((0x1u << (n - i)) - 1);
+      const auto x = _mm512_maskz_loadu_epi64(m, (const void*)(p + i));
+      const auto y = _mm512_maskz_loadu_epi64(m, (const void*)(q + i));
+      const auto z = apply<O>(x, y);
+      return _mm512_test_epi64_mask(z, z) != 0;
+    }
+    return false;
+  }
+
+  /** Two quads at a time. */
+  static void not_sse2(uint64_t* dst, const uint64_t* src, size_t n, bool stream) {
+    assert((uintptr_t) dst % 32 == 0);
+    assert((uintptr_t) src % 32 == 0);
+    const auto ones = _mm_set1_epi32(-1);
+    size_t i = 0;
+    if (stream) {
+      for (; i + 2 <= n; i += 2) {
+        const auto x = _mm_load_si128((const __m128i*)(src + i));
+        _mm_stream_si128((__m128i*)(dst + i), _mm_xor_si128(x, ones));
+      }
+      _mm_sfence();
+    }
+    for (; i + 2 <= n; i += 2) {
+      const auto x = _mm_load_si128((const __m128i*)(src + i));
+      _mm_store_si128((__m128i*)(dst + i), _mm_xor_si128(x, ones));
+    }
+    for (; i < n; ++i) {
+      dst[i] = ~src[i];
+    }
+  }
+
+  /** Four quads at a time. */
+  __attribute__((target("avx2")))
+  static void not_avx2(uint64_t* dst, const uint64_t* src, size_t n, bool stream) {
+    assert((uintptr_t) dst % 32 == 0);
+    assert((uintptr_t) src % 32 == 0);
+    const auto ones = _mm256_set1_epi32(-1);
+    size_t i = 0;
+    if (stream) {
+      for (; i + 4 <= n; i += 4) {
+        const auto x = _mm256_load_si256((const __m256i*)(src + i));
+        _mm256_stream_si256((__m256i*)(dst + i), _mm256_xor_si256(x, ones));
+      }
+      _mm_sfence();
+    }
+    for (; i + 4 <= n; i += 4) {
+      const auto x = _mm256_load_si256((const __m256i*)(src + i));
+      _mm256_store_si256((__m256i*)(dst + i), _mm256_xor_si256(x, ones));
+    }
+    for (; i < n; ++i) {
+      dst[i] = ~src[i];
+    }
+  }
+
+  /** Eight quads at a time, with a masked tail. Streaming stores need 64-byte
+   * alignment at this width, so those are left to the avx2 version. */
+  __attribute__((target("avx512f")))
+  static void not_avx512(uint64_t* dst, const uint64_t* src, size_t n, bool stream) {
+    if (stream) {
+      not_avx2(dst, src, n, stream);
+      return;
+    }
+    const auto ones = _mm512_set1_epi32(-1);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      const auto x = _mm512_loadu_si512((const void*)(src + i));
+      _mm512_storeu_si512((void*)(dst + i), _mm512_xor_si512(x, ones));
+    }
+    if (i < n) {
+      const auto m = (__mmask8)((0x1u << (n - i)) - 1);
+      const auto x = _mm512_maskz_loadu_epi64(m, (const void*)(src + i));
+      _mm512_mask_storeu_epi64((void*)(dst + i), m, _mm512_xor_si512(x, ones));
+    }
+  }
+
+  /** Returns the key that each hash lane xors its quads with. For every
+   * stripe, lane j adds the low half of p[j] ^ key[j] times its high half,
+   * along with p[j ^ 1], so that each quad reaches two lanes. */
+  static const uint64_t* hash_keys() {
+    alignas(64) static const uint64_t keys[8] = {
+      0x9e3779b97f4a7c15ull, 0xbf58476d1ce4e5b9ull, 0x94d049bb133111ebull, 0xd6e8feb86659fd93ull,
+      0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull
+    };
+    return keys;
+  }
+  /** Mixes the hash lanes and the quads after the last full stripe. */
+  static uint64_t hash_finish(const uint64_t* acc, const uint64_t* p, size_t n, uint64_t seed) {
+    const auto k = hash_keys();
+    auto h = mix(seed ^ (n * k[0]));
+    for (size_t j = 0; j < 8; ++j) {
+      h = mix(h ^ acc[j]);
+    }
+    for (size_t j = n / 8 * 8; j < n; ++j) {
+      h = mix(h ^ p[j] ^ k[j % 8]);
+    }
+    return h;
+  }
+
+  /** Two lanes at a time. */
+  static uint64_t hash_sse2(const uint64_t* p, size_t n, uint64_t seed) {
+    const auto k = hash_keys();
+    __m128i acc[4];
+    __m128i key[4];
+    for (size_t r = 0; r < 4; ++r) {
+      acc[r] = key[r] = _mm_load_si128((const __m128i*)(k + 2 * r));
+    }
+    for (size_t i = 0; i + 8 <= n; i += 8) {
+      for (size_t r = 0; r < 4; ++r) {
+        const auto x = _mm_loadu_si128((const __m128i*)(p + i + 2 * r));
+        const auto d = _mm_xor_si128(x, key[r]);
+        const auto m = _mm_mul_epu32(d, _mm_srli_epi64(d, 32));
+        const auto s = _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2));
+        acc[r] = _mm_add_epi64(acc[r], _mm_add_epi64(m, s));
+      }
+    }
+    alignas(64) uint64_t lanes[8];
+    for (size_t r = 0; r < 4; ++r) {
+      _mm_store_si128((__m128i*)(lanes + 2 * r), acc[r]);
+    }
+    return hash_finish(lanes, p, n, seed);
+  }
+
+  /** Four lanes at a time. */
+  __attribute__((target("avx2")))
+  static uint64_t hash_avx2(const uint64_t* p, size_t n, uint64_t seed) {
+    const auto k = hash_keys();
+    const auto key0 = _mm256_load_si256((const __m256i*) k);
+    const auto key1 = _mm256_load_si256((const __m256i*)(k + 4));
+    auto acc0 = key0;
+    auto acc1 = key1;
+    for (size_t i = 0; i + 8 <= n; i += 8) {
+      const auto x0 = _mm256_loadu_si256((const __m256i*)(p + i));
+      const auto x1 = _mm256_loadu_si256((const __m256i*)(p + i + 4));
+      const auto d0 = _mm256_xor_si256(x0, key0);
+      const auto d1 = _mm256_xor_si256(x1, key1);
+      const auto m0 = _mm256_mul_epu32(d0, _mm256_srli_epi64(d0, 32));
+      const auto m1 = _mm256_mul_epu32(d1, _mm256_srli_epi64(d1, 32));
+      const auto s0 = _mm256_shuffle_epi32(x0, _MM_SHUFFLE(1, 0, 3, 2));
+      const auto s1 = _mm256_shuffle_epi32(x1, _MM_SHUFFLE(1, 0, 3, 2));
+      acc0 = _mm256_add_epi64(acc0, _mm256_add_epi64(m0, s0));
+      acc1 = _mm256_add_epi64(acc1, _mm256_add_epi64(m1, s1));
+    }
+    alignas(64) uint64_t lanes[8];
+    _mm256_store_si256((__m256i*) lanes, acc0);
+    _mm256_store_si256((__m256i*)(lanes + 4), acc1);
+    return hash_finish(lanes, p, n, seed);
+  }
+
+  /** Eight lanes at a time, with two stripes in flight that are summed at the
+   * end. The zero-masking forms of the intrinsics are used with every lane
+   * enabled, since gcc warns about the undefined pass-through operand of the
+   * plain forms. */
+  __attribute__((target("avx512f")))
+  static uint64_t hash_avx512(const uint64_t* p, size_t n, uint64_t seed) {
+    const auto key = _mm512_load_si512((const void*) hash_keys());
+    auto acc0 = key;
+    auto acc1 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      acc0 = hash_avx512_stripe(acc0, key, p + i);
+      acc1 = hash_avx512_stripe(acc1, key, p + i + 8);
+    }
+    if (i + 8 <= n) {
+      acc0 = hash_avx512_stripe(acc0, key, p + i);
+    }
+    alignas(64) uint64_t lanes[8];
+    _mm512_store_si512((void*) lanes, _mm512_add_epi64(acc0, acc1));
+    return hash_finish(lanes, p, n, seed);
+  }
+  /** Adds the eight quads at p to the hash lanes in acc. */
+  __attribute__((target("avx512f")))
+  static __m512i hash_avx512_stripe(__m512i acc, __m512i key, const uint64_t* p) {
+    const auto x = _mm512_loadu_si512((const void*) p);
+    const auto d = _mm512_xor_si512(x, key);
+    const auto m = _mm512_maskz_mul_epu32(0xff, d, _mm512_maskz_srli_epi64(0xff, d, 32));
+    const auto s = _mm512_maskz_shuffle_epi32(0xffff, x, (_MM_PERM_ENUM) _MM_SHUFFLE(1, 0, 3, 2));
+    return _mm512_add_epi64(acc, _mm512_add_epi64(m, s));
+  }
+};
+
+} // namespace cpputil
+
+#endif
@@ -17,48 +17,191 @@
 
 #include <cassert>
 #include <immintrin.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include <type_traits>
+
+#include "include/system/cpu_features.h"
+
 namespace cpputil {
 
+/* Bit twiddling on a single word. Everything that doesn't need popcnt, pdep
+ * or pext is constexpr. Where an instruction is available at compile time it
+ * is used directly; otherwise popcnt, pdep and pext are dispatched on the
+ * host, the rest use the portable version, and the result is the same. */
 template <typename T>
 class BitManip;
 
 template <>
 class BitManip<uint64_t> {
  public:
-  static size_t ntz(uint64_t x) {
+  /** Returns the number of trailing zeros; ntz(0) is 64. */
+  static constexpr size_t ntz(uint64_t x) {
 #ifdef __BMI__
-    return __builtin_ctzll(x);
+    return __builtin_ia32_tzcnt_u64(x);
+#else
+    return x ? __builtin_ctzll(x) : 64;
+#endif
+  }
+  /** Returns the number of leading zeros; nlz(0) is 64. */
+  static constexpr size_t nlz(uint64_t x) {
+#ifdef __LZCNT__
+    return __builtin_ia32_lzcnt_u64(x);
 #else
-	// See https://graphics.stanford.edu/~seander/bithacks.html
-	uint64_t res = 64; 
-	x &= -((int64_t)x);
-	if (x) res--;
-	if (x & 0x00000000ffffffff) res -= 32;
-	if (x & 0x0000ffff0000ffff) res -= 16;
-	if (x & 0x00ff00ff00ff00ff) res -= 8;
-	if (x & 0x0f0f0f0f0f0f0f0f) res -= 4;
-	if (x & 0x3333333333333333) res -= 2;
-	if (x & 0x5555555555555555) res -= 1;
-	return res;
+    return x ? __builtin_clzll(x) : 64;
 #endif
   }
 
-	static size_t pop_count(uint64_t x) {
+  /** Returns the number of set bits. Without popcnt at compile time, this is
+   * dispatched the same way as pdep(). */
+  static size_t pop_count(uint64_t x) {
 #ifdef __POPCNT__
-		return __builtin_popcountll(x);
+    return __builtin_popcountll(x);
+#else
+    return pop_count_kernel()(x);
+#endif
+  }
+  /** Returns 1 if an odd number of bits are set, and 0 otherwise. */
+  static constexpr size_t parity(uint64_t x) {
+    return __builtin_parityll(x);
+  }
+
+  /** Returns x with the order of its bits reversed. */
+  static constexpr uint64_t reverse(uint64_t x) {
+    return __builtin_bswap64(swap_bits(swap_bits(swap_bits(x, 1, 0x5555555555555555),
+                                       2, 0x3333333333333333), 4, 0x0f0f0f0f0f0f0f0f));
+  }
+
+  /** Returns the len bits of x that start at bit lo, in the low bits of the
+   * result; lo must be less than 64, and len at most 64. */
+  static constexpr uint64_t extract_bits(uint64_t x, size_t lo, size_t len) {
+    return len >= 64 ? x >> lo : (x >> lo) & ((0x1ull << len) - 1);
+  }
+  /** Returns the lowest set bit of x, or 0 if there isn't one. */
+  static constexpr uint64_t isolate_rightmost(uint64_t x) {
+    return x & (0 - x);
+  }
+  /** Returns the next larger word with as many set bits as x, which must not
+   * be zero. The word after the largest one wraps around to a smaller one. */
+  static constexpr uint64_t next_permutation(uint64_t x) {
+    // See https://graphics.stanford.edu/~seander/bithacks.html
+    return next_permutation(x, x | (x - 1));
+  }
+
+  typedef size_t (*count_type)(uint64_t);
+  typedef uint64_t (*deposit_type)(uint64_t, uint64_t);
+  typedef size_t (*select_type)(uint64_t, size_t);
+
+  /** Returns the pop_count() used on this host. */
+  static count_type pop_count_kernel() {
+    static const count_type k = CpuFeatures::has_popcnt() ? pop_count_popcnt : pop_count_scalar;
+    return k;
+  }
+  /** pop_count() in one instruction. */
+  __attribute__((target("popcnt")))
+  static size_t pop_count_popcnt(uint64_t x) {
+    return __builtin_popcountll(x);
+  }
+  /** pop_count() by adding up neighbouring bits, then pairs, then nibbles. */
+  static constexpr size_t pop_count_scalar(uint64_t x) {
+    // See https://graphics.stanford.edu/~seander/bithacks.html
+    return (byte_counts(x) * 0x0101010101010101) >> 56;
+  }
+
+  /** Deposits the low bits of x at the set bits of m, in order. Without bmi2
+   * at compile time, the host is asked once whether it has pdep, and the
+   * answer is kept. */
+  static uint64_t pdep(uint64_t x, uint64_t m) {
+#ifdef __BMI2__
+    return _pdep_u64(x, m);
+#else
+    return pdep_kernel()(x, m);
+#endif
+  }
+  /** Gathers the bits of x at the set bits of m into the low bits of the
+   * result, in order. Dispatched the same way as pdep(). */
+  static uint64_t pext(uint64_t x, uint64_t m) {
+#ifdef __BMI2__
+    return _pext_u64(x, m);
 #else
-	// See https://graphics.stanford.edu/~seander/bithacks.html
-	uint64_t res = x - ((x >> 1) & 0x5555555555555555);
-	res = ((res >> 2) & 0x3333333333333333) + (res & 0x3333333333333333);
-	res = ((res >> 4) + res) & 0x0f0f0f0f0f0f0f0f;
-	res = ((res >> 8) + res) & 0x00ff00ff00ff00ff;
-	res = ((res >> 16) + res) & 0x0000ffff0000ffff;
-	res = ((res >> 32) + res) & 0x00000000ffffffff;
-	return res;
+    return pext_kernel()(x, m);
 #endif
-	}
+  }
+
+  /** Returns the pdep() used on this host. */
+  static deposit_type pdep_kernel() {
+    static const deposit_type k = CpuFeatures::has_avx2() ? pdep_bmi2 : pdep_scalar;
+    return k;
+  }
+  /** Returns the pext() used on this host. */
+  static deposit_type pext_kernel() {
+    static const deposit_type k = CpuFeatures::has_avx2() ? pext_bmi2 : pext_scalar;
+    return k;
+  }
+  /** pdep() in one instruction. */
+  __attribute__((target("bmi2")))
+  static uint64_t pdep_bmi2(uint64_t x, uint64_t m) {
+    return _pdep_u64(x, m);
+  }
+  /** pext() in one instruction. */
+  __attribute__((target("bmi2")))
+  static uint64_t pext_bmi2(uint64_t x, uint64_t m) {
+    return _pext_u64(x, m);
+  }
+  /** pdep() one set bit of m at a time, without branching on the bits of x. */
+  static uint64_t pdep_scalar(uint64_t x, uint64_t m) {
+    uint64_t res = 0;
+    for (; m; x >>= 1, unset_rightmost(m)) {
+      res |= isolate_rightmost(m) & (0 - (x & 0x1));
+    }
+    return res;
+  }
+  /** pext() one set bit of m at a time, without branching on the bits of x. */
+  static uint64_t pext_scalar(uint64_t x, uint64_t m) {
+    uint64_t res = 0;
+    for (size_t i = 0; m; ++i, unset_rightmost(m)) {
+      res |= (uint64_t)((x & isolate_rightmost(m)) != 0) << i;
+    }
+    return res;
+  }
+
+  /** Returns the index of the r'th (counting from zero) set bit; r must be
+   * less than pop_count(x). Dispatched the same way as pdep(). */
+  static size_t select(uint64_t x, size_t r) {
+    assert(r < pop_count(x));
+#ifdef __BMI2__
+    return _tzcnt_u64(_pdep_u64(0x1ull << r, x));
+#else
+    return select_kernel()(x, r);
+#endif
+  }
+
+  /** Returns the select() used on this host. */
+  static select_type select_kernel() {
+    static const select_type k = CpuFeatures::has_avx2() ? select_bmi2 : select_scalar;
+    return k;
+  }
+  /** Deposits a bit at the r'th set bit of x, and counts the zeros below it. */
+  __attribute__((target("bmi,bmi2")))
+  static size_t select_bmi2(uint64_t x, size_t r) {
+    return _tzcnt_u64(_pdep_u64(0x1ull << r, x));
+  }
+  /** Skips whole bytes using a running count of the set bits in each byte,
+   * then walks the bits of the byte that holds the answer. */
+  static size_t select_scalar(uint64_t x, size_t r) {
+    const auto c = byte_counts(x) * 0x0101010101010101;
+
+    size_t i = 0;
+    for (; i < 56 && ((c >> i) & 0xff) <= r; i += 8);
+    if (i > 0) {
+      r -= (c >> (i - 8)) & 0xff;
+    }
+    for (x >>= i; r > 0; --r) {
+      unset_rightmost(x);
+    }
+    return i + ntz(x);
+  }
 
   static uint64_t& unset_rightmost(uint64_t& x) {
 #ifdef __BMI__
@@ -76,8 +219,209 @@ class BitManip<uint64_t> {
       return (x &= ~((0x1ul << n) - 1));
     }
   }
+
+ private:
+  /** Returns the number of set bits in each byte of x, in that byte. */
+  static constexpr uint64_t byte_counts(uint64_t x) {
+    return nibble_sums(pair_sums(x - ((x >> 1) & 0x5555555555555555)));
+  }
+  /** Adds neighbouring 2-bit counts. */
+  static constexpr uint64_t pair_sums(uint64_t x) {
+    return (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+  }
+  /** Adds neighbouring 4-bit counts. */
+  static constexpr uint64_t nibble_sums(uint64_t x) {
+    return (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
+  }
+  /** Swaps the groups of n bits selected by m with the ones above them. */
+  static constexpr uint64_t swap_bits(uint64_t x, size_t n, uint64_t m) {
+    return ((x >> n) & m) | ((x & m) << n);
+  }
+  /** next_permutation(), given t, which is x with its trailing zeros set. The
+   * shift is split in two so that it is never by 64. */
+  static constexpr uint64_t next_permutation(uint64_t x, uint64_t t) {
+    return (t + 1) | ((isolate_rightmost(~t) - 1) >> ntz(x) >> 1);
+  }
+};
+
+/* The same operations on uint8_t, uint16_t and uint32_t. Each one widens its
+ * argument to 64 bits and narrows the result. */
+template <typename T>
+class BitManip {
+  static_assert(std::is_unsigned<T>::value && sizeof(T) < 8,
+                "BitManip is only defined for unsigned words of 64 bits or fewer");
+
+  typedef BitManip<uint64_t> Wide;
+  enum : size_t {
+    WIDTH = 8 * sizeof(T)
+  };
+
+ public:
+  /** Returns the number of trailing zeros; ntz(0) is the width of T. */
+  static constexpr size_t ntz(T x) {
+    return Wide::ntz(x | (0x1ull << WIDTH));
+  }
+  /** Returns the number of leading zeros; nlz(0) is the width of T. */
+  static constexpr size_t nlz(T x) {
+    return Wide::nlz(x) - (64 - WIDTH);
+  }
+  /** Returns the number of set bits. */
+  static size_t pop_count(T x) {
+    return Wide::pop_count(x);
+  }
+  /** Returns 1 if an odd number of bits are set, and 0 otherwise. */
+  static constexpr size_t parity(T x) {
+    return Wide::parity(x);
+  }
+  /** Returns x with the order of its bits reversed. */
+  static constexpr T reverse(T x) {
+    return Wide::reverse(x) >> (64 - WIDTH);
+  }
+  /** Returns the len bits of x that start at bit lo, in the low bits of the
+   * result; lo must be less than the width of T. */
+  static constexpr T extract_bits(T x, size_t lo, size_t len) {
+    return Wide::extract_bits(x, lo, len);
+  }
+  /** Returns the lowest set bit of x, or 0 if there isn't one. */
+  static constexpr T isolate_rightmost(T x) {
+    return Wide::isolate_rightmost(x);
+  }
+  /** Returns the next larger word with as many set bits as x, which must not
+   * be zero. The word after the largest one wraps around to a smaller one. */
+  static constexpr T next_permutation(T x) {
+    return Wide::next_permutation(x);
+  }
+  /** Deposits the low bits of x at the set bits of m, in order. */
+  static T pdep(T x, T m) {
+    return Wide::pdep(x, m);
+  }
+  /** Gathers the bits of x at the set bits of m into the low bits of the
+   * result, in order. */
+  static T pext(T x, T m) {
+    return Wide::pext(x, m);
+  }
+  /** Returns the index of the r'th (counting from zero) set bit; r must be
+   * less than pop_count(x). */
+  static size_t select(T x, size_t r) {
+    return Wide::select(x, r);
+  }
+
+  static T& unset_rightmost(T& x) {
+    return (x &= (x - 1));
+  }
+
+  static T& unset_rightmost(T& x, size_t n) {
+    assert(n <= WIDTH);
+    return (x = n == WIDTH ? 0 : x & ~((0x1ull << n) - 1));
+  }
+};
+
+#if defined(__AVX2__) && defined(__AVX__)
+
+/* The same operations on 256 bits, where bit 0 is the low bit of the first
+ * quad. gcc warns that it drops the attributes of __m256i when that is used
+ * as a template argument, so this is BitManip<__v4di>; every __m256i converts
+ * to a __v4di and back. There is no pdep, pext or next_permutation at this
+ * width. */
+template <>
+class BitManip<__v4di> {
+ public:
+  /** Returns the number of trailing zeros; ntz(0) is 256. */
+  static size_t ntz(__m256i x) {
+    const auto nz = nonzero_quads(x);
+    if (nz == 0) {
+      return 256;
+    }
+    const auto i = BitManip<uint64_t>::ntz(nz);
+    return 64 * i + BitManip<uint64_t>::ntz(quad(x, i));
+  }
+  /** Returns the number of leading zeros; nlz(0) is 256. */
+  static size_t nlz(__m256i x) {
+    const auto nz = nonzero_quads(x);
+    if (nz == 0) {
+      return 256;
+    }
+    const auto i = 63 - BitManip<uint64_t>::nlz(nz);
+    return 64 * (3 - i) + BitManip<uint64_t>::nlz(quad(x, i));
+  }
+  /** Returns the number of set bits. */
+  static size_t pop_count(__m256i x) {
+    return BitManip<uint64_t>::pop_count(_mm256_extract_epi64(x, 0)) +
+           BitManip<uint64_t>::pop_count(_mm256_extract_epi64(x, 1)) +
+           BitManip<uint64_t>::pop_count(_mm256_extract_epi64(x, 2)) +
+           BitManip<uint64_t>::pop_count(_mm256_extract_epi64(x, 3));
+  }
+  /** Returns 1 if an odd number of bits are set, and 0 otherwise. */
+  static size_t parity(__m256i x) {
+    const auto y = _mm_xor_si128(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    return BitManip<uint64_t>::parity(_mm_cvtsi128_si64(y) ^ _mm_extract_epi64(y, 1));
+  }
+  /** Returns x with the order of its bits reversed. Bits are reversed within
+   * each byte by looking up nibbles, then the bytes are put in reverse order. */
+  static __m256i reverse(__m256i x) {
+    const auto lut = _mm256_setr_epi8(0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+                                      0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf,
+                                      0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+                                      0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf);
+    const auto lo = _mm256_and_si256(x, _mm256_set1_epi8(0x0f));
+    const auto hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi8(0x0f));
+    const auto bytes = _mm256_or_si256(_mm256_slli_epi16(_mm256_shuffle_epi8(lut, lo), 4),
+                                       _mm256_shuffle_epi8(lut, hi));
+    const auto order = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(bytes, order), 0x4e);
+  }
+  /** Returns the len bits of x that start at bit lo, in the low bits of the
+   * result; lo must be less than 256, and len at most 64. */
+  static uint64_t extract_bits(__m256i x, size_t lo, size_t len) {
+    assert(lo < 256);
+    assert(len <= 64);
+    alignas(32) uint64_t q[5];
+    _mm256_store_si256((__m256i*) q, x);
+    q[4] = 0;
+    const auto i = lo / 64;
+    const auto sh = lo % 64;
+    const auto y = sh == 0 ? q[i] : (q[i] >> sh) | (q[i + 1] << (64 - sh));
+    return BitManip<uint64_t>::extract_bits(y, 0, len);
+  }
+  /** Returns the lowest set bit of x, or 0 if there isn't one. */
+  static __m256i isolate_rightmost(__m256i x) {
+    alignas(32) uint64_t q[4] = {0, 0, 0, 0};
+    const auto nz = nonzero_quads(x);
+    if (nz) {
+      const auto i = BitManip<uint64_t>::ntz(nz);
+      q[i] = BitManip<uint64_t>::isolate_rightmost(quad(x, i));
+    }
+    return _mm256_load_si256((const __m256i*) q);
+  }
+
+  static __m256i& unset_rightmost(__m256i& x) {
+    const auto nz = nonzero_quads(x);
+    if (nz) {
+      alignas(32) uint64_t q[4];
+      _mm256_store_si256((__m256i*) q, x);
+      BitManip<uint64_t>::unset_rightmost(q[BitManip<uint64_t>::ntz(nz)]);
+      x = _mm256_load_si256((const __m256i*) q);
+    }
+    return x;
+  }
+
+ private:
+  /** Returns a mask with bit i set if quad i of x is not zero. */
+  static uint64_t nonzero_quads(__m256i x) {
+    const auto z = _mm256_cmpeq_epi64(x, _mm256_setzero_si256());
+    return ~_mm256_movemask_pd(_mm256_castsi256_pd(z)) & 0xf;
+  }
+  /** Returns quad i of x. */
+  static uint64_t quad(__m256i x, size_t i) {
+    alignas(32) uint64_t q[4];
+    _mm256_store_si256((__m256i*) q, x);
+    return q[i];
+  }
 };
 
+#endif
+
 } // namespace cpputil
 
 #endif
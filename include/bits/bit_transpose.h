@@ -0,0 +1,172 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_BITS_BIT_TRANSPOSE_H
+#define CPPUTIL_INCLUDE_BITS_BIT_TRANSPOSE_H
+
+#include <cassert>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <immintrin.h>
+
+#include "include/system/cpu_features.h"
+
+namespace cpputil {
+
+/* Transposes square blocks of bits, and gathers columns out of them. A block
+ * is a run of rows, one quad wide, that are stride quads apart; bit c of row r
+ * ends up as bit r of row c. Each operation has a scalar and an avx2 version,
+ * which is picked once, from CpuFeatures. */
+class BitTranspose {
+ public:
+  typedef void (*kernel_type)(const uint64_t*, size_t, uint64_t*, size_t);
+  typedef uint64_t (*gather_type)(const uint64_t*, size_t, size_t);
+
+  /** Transposes the 64x64 block at src into the 64x64 block at dst; the two
+   * must not overlap. */
+  static void transpose_64(const uint64_t* src, size_t src_stride, uint64_t* dst,
+                           size_t dst_stride) {
+    kernel()(src, src_stride, dst, dst_stride);
+  }
+  /** Transposes the 256x256 block at src into the 256x256 block at dst; the
+   * two must not overlap. This is sixteen 64x64 transposes, with block (i, j)
+   * going to block (j, i). */
+  static void transpose_256(const uint64_t* src, size_t src_stride, uint64_t* dst,
+                            size_t dst_stride) {
+    const auto k = kernel();
+    for (size_t i = 0; i < 4; ++i) {
+      for (size_t j = 0; j < 4; ++j) {
+        k(src + 64 * i * src_stride + j, src_stride, dst + 64 * j * dst_stride + i, dst_stride);
+      }
+    }
+  }
+  /** Returns a quad holding the given bit of each of the 64 rows at src. */
+  static uint64_t gather_64(const uint64_t* src, size_t stride, size_t bit) {
+    return gather()(src, stride, bit);
+  }
+
+  /** Returns the transpose_64() used on this host. */
+  static kernel_type kernel() {
+    static const kernel_type k = CpuFeatures::has_avx2() ? avx2 : scalar;
+    return k;
+  }
+  /** Returns the gather_64() used on this host. */
+  static gather_type gather() {
+    static const gather_type g = CpuFeatures::has_avx2() ? gather_avx2 : gather_scalar;
+    return g;
+  }
+
+  /** Six rounds of swaps. Round j swaps the upper half of each group of 2j
+   * columns in row k with the lower half in row k + j. See Hacker's Delight,
+   * section 7-3. */
+  static void scalar(const uint64_t* src, size_t src_stride, uint64_t* dst, size_t dst_stride) {
+    uint64_t a[64];
+    for (size_t i = 0; i < 64; ++i) {
+      a[i] = src[i * src_stride];
+    }
+    uint64_t m = 0x00000000ffffffff;
+    for (size_t j = 32; j != 0; j >>= 1, m ^= m << j) {
+      for (size_t k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+        const auto t = ((a[k] >> j) ^ a[k | j]) & m;
+        a[k | j] ^= t;
+        a[k] ^= t << j;
+      }
+    }
+    for (size_t i = 0; i < 64; ++i) {
+      dst[i * dst_stride] = a[i];
+    }
+  }
+
+  /** The same rounds on four rows at a time. Register k holds rows k, k + 16,
+   * k + 32 and k + 48, so that the rounds for rows that are 1, 2, 4 and 8 apart
+   * pair up whole registers, and only the last two need to shuffle lanes. */
+  __attribute__((target("avx2")))
+  static void avx2(const uint64_t* src, size_t src_stride, uint64_t* dst, size_t dst_stride) {
+    __m256i v[16];
+    for (size_t k = 0; k < 16; ++k) {
+      v[k] = _mm256_setr_epi64x(src[k * src_stride], src[(k + 16) * src_stride],
+                                src[(k + 32) * src_stride], src[(k + 48) * src_stride]);
+    }
+    swap_registers<8>(v, _mm256_set1_epi64x(0x00ff00ff00ff00ff));
+    swap_registers<4>(v, _mm256_set1_epi64x(0x0f0f0f0f0f0f0f0f));
+    swap_registers<2>(v, _mm256_set1_epi64x(0x3333333333333333));
+    swap_registers<1>(v, _mm256_set1_epi64x(0x5555555555555555));
+
+    const auto m16 = _mm256_set1_epi64x(0x0000ffff0000ffff);
+    const auto m32 = _mm256_set1_epi64x(0x00000000ffffffff);
+    alignas(32) uint64_t q[4];
+    for (size_t k = 0; k < 16; ++k) {
+      // Neighbouring lanes are 16 rows apart, and halves are 32 rows apart
+      const auto x = swap_lanes<32, 0x4e, 0xf0>(swap_lanes<16, 0xb1, 0xcc>(v[k], m16), m32);
+      _mm256_store_si256((__m256i*) q, x);
+      dst[k * dst_stride] = q[0];
+      dst[(k + 16) * dst_stride] = q[1];
+      dst[(k + 32) * dst_stride] = q[2];
+      dst[(k + 48) * dst_stride] = q[3];
+    }
+  }
+
+  /** One row at a time. */
+  static uint64_t gather_scalar(const uint64_t* src, size_t stride, size_t bit) {
+    assert(bit < 64);
+    uint64_t res = 0;
+    for (size_t i = 0; i < 64; ++i) {
+      res |= ((src[i * stride] >> bit) & 0x1) << i;
+    }
+    return res;
+  }
+  /** Four rows at a time: the bit is shifted to the top of each lane, where
+   * movemask collects it. */
+  __attribute__((target("avx2")))
+  static uint64_t gather_avx2(const uint64_t* src, size_t stride, size_t bit) {
+    assert(bit < 64);
+    const auto sh = _mm_cvtsi64_si128(63 - bit);
+    uint64_t res = 0;
+    for (size_t i = 0; i < 64; i += 4) {
+      const auto x = _mm256_setr_epi64x(src[i * stride], src[(i + 1) * stride],
+                                        src[(i + 2) * stride], src[(i + 3) * stride]);
+      const auto m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_sll_epi64(x, sh)));
+      res |= (uint64_t) m << i;
+    }
+    return res;
+  }
+
+ private:
+  /** Runs round J on registers that are J apart. */
+  template <int J>
+  __attribute__((target("avx2")))
+  static void swap_registers(__m256i* v, __m256i m) {
+    for (size_t k = 0; k < 16; k = ((k | J) + 1) & ~J) {
+      const auto t = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(v[k], J), v[k | J]), m);
+      v[k | J] = _mm256_xor_si256(v[k | J], t);
+      v[k] = _mm256_xor_si256(v[k], _mm256_slli_epi64(t, J));
+    }
+  }
+  /** Runs round J on the lanes of x that permutation P pairs up; blend B
+   * picks the lanes that hold the later row of each pair. */
+  template <int J, int P, int B>
+  __attribute__((target("avx2")))
+  static __m256i swap_lanes(__m256i x, __m256i m) {
+    const auto y = _mm256_permute4x64_epi64(x, P);
+    const auto lo = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(x, J), y), m);
+    const auto hi = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(y, J), x), m);
+    return _mm256_blend_epi32(_mm256_xor_si256(x, _mm256_slli_epi64(lo, J)),
+                              _mm256_xor_si256(x, hi), B);
+  }
+};
+
+} // namespace cpputil
+
+#endif
@@ -0,0 +1,120 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_BITS_BULK_COPY_H
+#define CPPUTIL_INCLUDE_BITS_BULK_COPY_H
+
+#include <cassert>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <immintrin.h>
+#include <xmmintrin.h>
+
+namespace cpputil {
+
+/** How a bulk write treats the cache. Cached writes leave the destination
+ * in cache, which is what you want if it is about to be read. Streaming
+ * writes go around the cache, so writing hundreds of megabytes doesn't evict
+ * everyone else's working set. Auto streams writes of at least
+ * BulkCopy::THRESHOLD bytes. */
+enum class StoreMode {
+  AUTO,
+  CACHED,
+  STREAMING
+};
+
+/** Copies and fills of quad arrays. Both arrays must be 32-byte aligned. */
+class BulkCopy {
+ public:
+  enum : size_t {
+    /** The size at which auto mode starts to stream; roughly a last level cache. */
+    THRESHOLD = 1 << 23,
+    /** How far ahead of a streaming copy the source is prefetched, in quads. */
+    PREFETCH = 64
+  };
+
+  /** Returns true if a write of the given size should stream. */
+  static bool streams(StoreMode mode, size_t bytes) {
+    return mode == StoreMode::STREAMING || (mode == StoreMode::AUTO && bytes >= THRESHOLD);
+  }
+
+  /** Copies n quads from src to dst. */
+  static void copy(uint64_t* dst, const uint64_t* src, size_t n, StoreMode mode) {
+    assert((uintptr_t) dst % 32 == 0);
+    assert((uintptr_t) src % 32 == 0);
+    size_t i = 0;
+
+    if (streams(mode, 8 * n)) {
+#if defined(__AVX2__) && defined(__AVX__)
+      for (; i + 4 <= n; i += 4) {
+        _mm_prefetch((const char*)(src + i + PREFETCH), _MM_HINT_NTA);
+        const auto x = _mm256_load_si256((const __m256i*)(src + i));
+        _mm256_stream_si256((__m256i*)(dst + i), x);
+      }
+#else
+      for (; i + 2 <= n; i += 2) {
+        _mm_prefetch((const char*)(src + i + PREFETCH), _MM_HINT_NTA);
+        const auto x = _mm_load_si128((const __m128i*)(src + i));
+        _mm_stream_si128((__m128i*)(dst + i), x);
+      }
+#endif
+      _mm_sfence();
+    }
+
+#if defined(__AVX2__) && defined(__AVX__)
+    for (; i + 4 <= n; i += 4) {
+      auto x = _mm256_load_si256((__m256i*) &src[i]);
+      _mm256_store_si256((__m256i*) &dst[i], x);
+    }
+#elif defined(__AVX__)
+    for (; i + 2 <= n; i += 2) {
+      auto x = _mm_load_si128((__m128i*) &src[i]);
+      _mm_store_si128((__m128i*)&dst[i], x);
+    }
+#endif
+    for (; i < n; ++i) {
+      dst[i] = src[i];
+    }
+  }
+
+  /** Sets n quads of dst to val. */
+  static void fill(uint64_t* dst, size_t n, uint64_t val, StoreMode mode) {
+    assert((uintptr_t) dst % 32 == 0);
+    size_t i = 0;
+
+    if (streams(mode, 8 * n)) {
+#if defined(__AVX2__) && defined(__AVX__)
+      const auto x = _mm256_set1_epi64x(val);
+      for (; i + 4 <= n; i += 4) {
+        _mm256_stream_si256((__m256i*)(dst + i), x);
+      }
+#else
+      const auto x = _mm_set1_epi64x(val);
+      for (; i + 2 <= n; i += 2) {
+        _mm_stream_si128((__m128i*)(dst + i), x);
+      }
+#endif
+      _mm_sfence();
+    }
+
+    for (; i < n; ++i) {
+      dst[i] = val;
+    }
+  }
+};
+
+} // namespace cpputil
+
+#endif
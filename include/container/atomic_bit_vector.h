@@ -0,0 +1,165 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_CONTAINER_ATOMIC_BIT_VECTOR_H
+#define CPPUTIL_INCLUDE_CONTAINER_ATOMIC_BIT_VECTOR_H
+
+#include <atomic>
+#include <cassert>
+#include <stdint.h>
+
+#include <vector>
+
+#include "include/bits/bit_manip.h"
+#include "include/container/bit_vector.h"
+
+namespace cpputil {
+
+/* A fixed-size bit vector that many threads can update at once without a
+ * lock. Every update is a single atomic operation on the quad that holds the
+ * bit. test_and_set() reads a bit before trying to set it, so threads that
+ * keep marking bits that are already set don't fight over the cache line.
+ *
+ * Single-bit operations default to acquire/release ordering, so a thread that
+ * sees a bit set also sees whatever its setter wrote before setting it. Bulk
+ * reads are relaxed: a snapshot taken while other threads are writing holds
+ * each quad as it was at some point during the snapshot, not necessarily all
+ * at the same point. */
+class AtomicBitVector {
+ public:
+  /** Creates an empty bit vector. */
+  AtomicBitVector() : num_bits_(0) { }
+  /** Creates a bit vector of n unset bits. */
+  explicit AtomicBitVector(size_t n) : contents_((n + 63) / 64), num_bits_(n) { }
+
+  /** Returns the number of bits in this vector. */
+  size_t num_bits() const {
+    return num_bits_;
+  }
+  /** Returns the number of quads in this vector. */
+  size_t num_quads() const {
+    return contents_.size();
+  }
+
+  /** Returns a bit. */
+  bool get_bit(size_t i, std::memory_order order = std::memory_order_acquire) const {
+    assert(i < num_bits_);
+    return contents_[i / 64].load(order) & (0x1ull << (i % 64));
+  }
+  /** Sets a bit and returns its previous value. */
+  bool test_and_set(size_t i, std::memory_order order = std::memory_order_acq_rel) {
+    assert(i < num_bits_);
+    const auto mask = 0x1ull << (i % 64);
+    auto& q = contents_[i / 64];
+    if (q.load(std::memory_order_acquire) & mask) {
+      return true;
+    }
+    return q.fetch_or(mask, order) & mask;
+  }
+  /** Unsets a bit and returns its previous value. */
+  bool test_and_reset(size_t i, std::memory_order order = std::memory_order_acq_rel) {
+    assert(i < num_bits_);
+    const auto mask = 0x1ull << (i % 64);
+    auto& q = contents_[i / 64];
+    if (!(q.load(std::memory_order_acquire) & mask)) {
+      return false;
+    }
+    return q.fetch_and(~mask, order) & mask;
+  }
+
+  /** Returns the i'th quad. */
+  uint64_t get_fixed_quad(size_t i, std::memory_order order = std::memory_order_acquire) const {
+    assert(i < num_quads());
+    return contents_[i].load(order);
+  }
+  /** Sets the bits of mask in the i'th quad, and returns the quad's previous
+   * value. Bits past the end of the vector are ignored. */
+  uint64_t fetch_or(size_t i, uint64_t mask,
+                    std::memory_order order = std::memory_order_acq_rel) {
+    assert(i < num_quads());
+    return contents_[i].fetch_or(mask & quad_mask(i), order);
+  }
+  /** Unsets the bits not in mask in the i'th quad, and returns the quad's
+   * previous value. */
+  uint64_t fetch_and(size_t i, uint64_t mask,
+                     std::memory_order order = std::memory_order_acq_rel) {
+    assert(i < num_quads());
+    return contents_[i].fetch_and(mask, order);
+  }
+
+  /** Returns the number of set bits, read with relaxed ordering. */
+  size_t num_set_bits() const {
+    size_t res = 0;
+    for (const auto& q : contents_) {
+      res += BitManip<uint64_t>::pop_count(q.load(std::memory_order_relaxed));
+    }
+    return res;
+  }
+
+  /** Copies every bit into dst, which is resized to match, reading with
+   * relaxed ordering. */
+  void snapshot(BitVector& dst) const {
+    dst.resize_for_bits(num_bits_);
+    auto out = dst.fixed_quad_begin();
+    for (size_t i = 0, ie = num_quads(); i < ie; ++i) {
+      out[i] = contents_[i].load(std::memory_order_relaxed);
+    }
+  }
+  /** Returns a copy of every bit, read with relaxed ordering. */
+  BitVector snapshot() const {
+    BitVector res;
+    snapshot(res);
+    return res;
+  }
+
+  /** Unsets every bit. Not atomic with respect to other updates as a whole,
+   * although each quad is cleared atomically. */
+  void reset() {
+    for (auto& q : contents_) {
+      q.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /** STL-compliant swap; not safe to call while other threads are updating
+   * either vector. */
+  void swap(AtomicBitVector& rhs) {
+    contents_.swap(rhs.contents_);
+    std::swap(num_bits_, rhs.num_bits_);
+  }
+
+ private:
+  std::vector<std::atomic<uint64_t>> contents_;
+  size_t num_bits_;
+
+  /** Returns the bits of the i'th quad that belong to this vector. */
+  uint64_t quad_mask(size_t i) const {
+    if (num_bits_ % 64 && i == num_bits_ / 64) {
+      return (0x1ull << (num_bits_ % 64)) - 1;
+    }
+    return -1ull;
+  }
+};
+
+} // namespace cpputil
+
+namespace std {
+
+/** STL-compliant swap. */
+inline void swap(cpputil::AtomicBitVector& lhs, cpputil::AtomicBitVector& rhs) {
+  lhs.swap(rhs);
+}
+
+} // namespace std
+
+#endif
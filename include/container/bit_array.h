@@ -15,14 +15,138 @@
 #ifndef CPPUTIL_INCLUDE_CONTAINER_BIT_ARRAY_H
 #define CPPUTIL_INCLUDE_CONTAINER_BIT_ARRAY_H
 
+#include <cassert>
 #include <stdint.h>
 
 #include <array>
 
+#include <immintrin.h>
+
+#include "include/bits/bit_manip.h"
+#include "include/container/bit_expr.h"
 #include "include/container/bit_string.h"
 
 namespace cpputil {
 
+/** Returns true if an unrolled kernel should take quads [i, e) four at a time. */
+constexpr bool bit_array_block(size_t i, size_t e) {
+#if defined(__AVX2__) && defined(__AVX__)
+  return i + 4 <= e;
+#else
+  return false && i + 4 <= e;
+#endif
+}
+
+/* Kernels over quads [I, E) of an expression operand, unrolled by template
+ * recursion. Each step takes four quads with AVX2 if there are four left and
+ * one quad otherwise, so a small array is handled in straight-line code that
+ * keeps its operands in registers. */
+template <size_t I, size_t E, bool Block = bit_array_block(I, E)>
+struct BitArrayKernel {
+  /** Writes the quads of x to dst. */
+  template <typename X>
+  static void eval(const X& x, uint64_t* dst) {
+    dst[I] = x.quad(I);
+    BitArrayKernel<I + 1, E>::eval(x, dst);
+  }
+  /** Returns the number of set bits in x. */
+  template <typename X>
+  static size_t count(const X& x) {
+    return BitManip<uint64_t>::pop_count(x.quad(I)) + BitArrayKernel<I + 1, E>::count(x);
+  }
+  /** Returns true if x has a set bit; doesn't stop early. */
+  template <typename X>
+  static bool any(const X& x) {
+    return (x.quad(I) != 0) | BitArrayKernel<I + 1, E>::any(x);
+  }
+  /** Calls f with the index of every set bit in p, in increasing order. */
+  template <typename F>
+  static void each(const uint64_t* p, F& f) {
+    for (auto q = p[I]; q != 0; q &= q - 1) {
+      f(64 * I + BitManip<uint64_t>::ntz(q));
+    }
+    BitArrayKernel<I + 1, E>::each(p, f);
+  }
+};
+
+template <size_t E>
+struct BitArrayKernel<E, E, false> {
+  template <typename X>
+  static void eval(const X&, uint64_t*) { }
+  template <typename X>
+  static size_t count(const X&) {
+    return 0;
+  }
+  template <typename X>
+  static bool any(const X&) {
+    return false;
+  }
+  template <typename F>
+  static void each(const uint64_t*, F&) { }
+};
+
+#if defined(__AVX2__) && defined(__AVX__)
+template <size_t I, size_t E>
+struct BitArrayKernel<I, E, true> {
+  template <typename X>
+  static void eval(const X& x, uint64_t* dst) {
+    _mm256_store_si256((__m256i*) &dst[I], x.block(I));
+    BitArrayKernel<I + 4, E>::eval(x, dst);
+  }
+  template <typename X>
+  static size_t count(const X& x) {
+    return BitManip<uint64_t>::pop_count(x.quad(I)) +
+           BitManip<uint64_t>::pop_count(x.quad(I + 1)) +
+           BitManip<uint64_t>::pop_count(x.quad(I + 2)) +
+           BitManip<uint64_t>::pop_count(x.quad(I + 3)) +
+           BitArrayKernel<I + 4, E>::count(x);
+  }
+  template <typename X>
+  static bool any(const X& x) {
+    const auto b = x.block(I);
+    return !_mm256_testz_si256(b, b) | BitArrayKernel<I + 4, E>::any(x);
+  }
+  template <typename F>
+  static void each(const uint64_t* p, F& f) {
+    BitArrayKernel<I, I + 4, false>::each(p, f);
+    BitArrayKernel<I + 4, E>::each(p, f);
+  }
+};
+#endif
+
+/** Operations on the first Q quads of an expression operand. Small arrays are
+ * unrolled; larger ones fall back to the loops used by every bit string. */
+template <size_t Q, bool Unroll = (Q <= 16)>
+struct BitArrayOps {
+  template <typename X>
+  static void eval(const X& x, uint64_t* dst) {
+    eval_quads(x, dst, 0, Q);
+  }
+  template <typename X>
+  static size_t count(const X& x) {
+    return count_quads(x, 0, Q);
+  }
+  template <typename X>
+  static bool any(const X& x) {
+    return any_quads(x, 0, Q);
+  }
+  template <typename F>
+  static void each(const uint64_t* p, F& f) {
+    for (size_t i = 0; i < Q; ++i) {
+      for (auto q = p[i]; q != 0; q &= q - 1) {
+        f(64 * i + BitManip<uint64_t>::ntz(q));
+      }
+    }
+  }
+};
+
+template <size_t Q>
+struct BitArrayOps<Q, true> : public BitArrayKernel<0, Q> { };
+
+/* A bit string whose length is fixed at compile time. Assignment from
+ * expressions, the compound operators, equality, counting and set bit
+ * iteration use kernels specialized for N; arrays of up to 1024 bits are
+ * fully unrolled. */
 template <size_t N>
 class BitArray : public BitString < std::array < uint64_t, (N + 63) / 64 >> {
  public:
@@ -30,6 +154,72 @@ class BitArray : public BitString < std::array < uint64_t, (N + 63) / 64 >> {
   BitArray() : BitString < std::array < uint64_t, (N + 63) / 64 >> () {
     this->num_bits_ = N;
   }
+  /** Creates a bit array from a bit-wise expression. */
+  template <typename E>
+  BitArray(const BitExpr<E>& e) : BitArray() {
+    *this = e;
+  }
+
+  using BitString < std::array < uint64_t, (N + 63) / 64 >>::operator=;
+
+  /** Expression assignment; evaluates rhs in a single pass. The bits past
+   * the end of the array are left unset. */
+  template <typename E>
+  BitArray& operator=(const BitExpr<E>& rhs) {
+    const auto e = BitExprOperand<E>::get(rhs.derived());
+    assert(e.num_bits() == N);
+    BitArrayOps < (N + 63) / 64 >::eval(e, quads());
+    if (N % 64) {
+      quads()[N / 64] &= TAIL;
+    }
+    return *this;
+  }
+
+  /** Bit-wise and. */
+  template <typename E>
+  BitArray& operator&=(const BitExpr<E>& rhs) {
+    return *this = *this & rhs;
+  }
+  /** Bit-wise or. */
+  template <typename E>
+  BitArray& operator|=(const BitExpr<E>& rhs) {
+    return *this = *this | rhs;
+  }
+  /** Bit-wise xor. */
+  template <typename E>
+  BitArray& operator^=(const BitExpr<E>& rhs) {
+    return *this = *this ^ rhs;
+  }
+
+  /** Equality. */
+  bool operator==(const BitArray& rhs) const {
+    return !any(*this ^ rhs);
+  }
+  /** Inequality. */
+  bool operator!=(const BitArray& rhs) const {
+    return any(*this ^ rhs);
+  }
+
+  /** Returns the number of set bits in this array. */
+  size_t num_set_bits() const {
+    auto res = BitArrayOps < N / 64 >::count(BitExprLeaf(*this));
+    if (N % 64) {
+      res += BitManip<uint64_t>::pop_count(quads()[N / 64] & TAIL);
+    }
+    return res;
+  }
+
+  /** Calls f with the index of every set bit in this array, in increasing
+   * order. Faster than a set bit index iterator for small arrays. */
+  template <typename F>
+  void for_each_set_bit(F f) const {
+    BitArrayOps < N / 64 >::each(quads(), f);
+    if (N % 64) {
+      for (auto q = quads()[N / 64] & TAIL; q != 0; q &= q - 1) {
+        f(N / 64 * 64 + BitManip<uint64_t>::ntz(q));
+      }
+    }
+  }
 
   /** Set all elements to zero. */
   void unset() {
@@ -39,9 +229,47 @@ class BitArray : public BitString < std::array < uint64_t, (N + 63) / 64 >> {
   /** Set all elements to one. */
   void set() {
     this->contents_.fill(-1);
+    this->mask_tail();
+  }
+
+ private:
+  enum : uint64_t {
+    /** The bits of the last quad that belong to this array, if it is partial. */
+    TAIL = (0x1ull << (N % 64)) - 1
+  };
+
+  /** Returns the quads. */
+  uint64_t* quads() {
+    return this->contents_.data();
+  }
+  /** Returns the quads. */
+  const uint64_t* quads() const {
+    return this->contents_.data();
+  }
+
+  /** Returns true if an expression has any set bits. */
+  template <typename E>
+  static bool any(const BitExpr<E>& expr) {
+    const auto e = BitExprOperand<E>::get(expr.derived());
+    if (BitArrayOps < N / 64 >::any(e)) {
+      return true;
+    }
+    return N % 64 && (e.quad(N / 64) & TAIL);
   }
 };
 
 } // namespace cpputil
 
+namespace std {
+
+/** STL-compliant hash. */
+template <size_t N>
+struct hash<cpputil::BitArray<N>> {
+  size_t operator()(const cpputil::BitArray<N>& bs) const {
+    return bs.hash();
+  }
+};
+
+} // namespace std
+
 #endif
@@ -0,0 +1,366 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_CONTAINER_BIT_EXPR_H
+#define CPPUTIL_INCLUDE_CONTAINER_BIT_EXPR_H
+
+#include <cassert>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <immintrin.h>
+
+#include "include/bits/bit_kernels.h"
+#include "include/bits/bit_manip.h"
+#include "include/bits/pop_count.h"
+
+namespace cpputil {
+
+template <typename T>
+class BitString;
+
+/* Bit-wise expressions over bit strings. Applying &, |, ^ or ~ to a bit
+ * string builds a small tree that describes the result rather than computing
+ * it. Nothing happens until the tree is assigned to a bit string or reduced
+ * with num_set_bits() or any_set_bits(), at which point every operand is read
+ * at most once and the destination, if any, is written exactly once.
+ * Expressions hold references to their bit string operands, so they should be
+ * assigned right away rather than stored with auto. */
+template <typename E>
+class BitExpr {
+ public:
+  /** Returns the concrete expression. */
+  const E& derived() const {
+    return *static_cast<const E*>(this);
+  }
+};
+
+/** An expression leaf; a read-only view of the quads of a bit string. */
+class BitExprLeaf {
+ public:
+  /** Creates a view of a bit string. */
+  template <typename T>
+  BitExprLeaf(const BitString<T>& b) : data_((const uint64_t*) b.data()), num_bits_(b.num_bits()) { }
+
+  /** Returns the number of bits in this expression. */
+  size_t num_bits() const {
+    return num_bits_;
+  }
+  /** Returns the i'th quad of this expression. */
+  uint64_t quad(size_t i) const {
+    return data_[i];
+  }
+  /** Returns the quads of the bit string. */
+  const uint64_t* data() const {
+    return data_;
+  }
+#if defined(__AVX2__) && defined(__AVX__)
+  /** Returns the four quads starting at i; i must be a multiple of four. */
+  __m256i block(size_t i) const {
+    return _mm256_load_si256((__m256i*) &data_[i]);
+  }
+#endif
+
+ private:
+  const uint64_t* data_;
+  size_t num_bits_;
+};
+
+/** Maps an expression to the type that is stored in the tree. Bit strings
+ * are stored as leaves, everything else by value. */
+template <typename E>
+struct BitExprOperand {
+  typedef E type;
+  static const E& get(const E& e) {
+    return e;
+  }
+};
+
+template <typename T>
+struct BitExprOperand<BitString<T>> {
+  typedef BitExprLeaf type;
+  static BitExprLeaf get(const BitString<T>& b) {
+    return BitExprLeaf(b);
+  }
+};
+
+/** A bit-wise binary operation. */
+template <typename Op, typename L, typename R>
+class BitBinaryExpr : public BitExpr<BitBinaryExpr<Op, L, R>> {
+ public:
+  /** Creates an expression from two operands of the same length. */
+  BitBinaryExpr(const L& l, const R& r) : l_(l), r_(r) {
+    assert(l_.num_bits() == r_.num_bits());
+  }
+
+  /** Returns the number of bits in this expression. */
+  size_t num_bits() const {
+    return l_.num_bits();
+  }
+  /** Returns the i'th quad of this expression. */
+  uint64_t quad(size_t i) const {
+    return Op::apply(l_.quad(i), r_.quad(i));
+  }
+  /** Returns the left operand. */
+  const L& left() const {
+    return l_;
+  }
+  /** Returns the right operand. */
+  const R& right() const {
+    return r_;
+  }
+#if defined(__AVX2__) && defined(__AVX__)
+  /** Returns the four quads starting at i; i must be a multiple of four. */
+  __m256i block(size_t i) const {
+    return Op::apply(l_.block(i), r_.block(i));
+  }
+#endif
+
+ private:
+  L l_;
+  R r_;
+};
+
+/** A bit-wise not. */
+template <typename E>
+class BitNotExpr : public BitExpr<BitNotExpr<E>> {
+ public:
+  /** Creates an expression from an operand. */
+  BitNotExpr(const E& e) : e_(e) { }
+
+  /** Returns the number of bits in this expression. */
+  size_t num_bits() const {
+    return e_.num_bits();
+  }
+  /** Returns the i'th quad of this expression. */
+  uint64_t quad(size_t i) const {
+    return ~e_.quad(i);
+  }
+  /** Returns the operand. */
+  const E& operand() const {
+    return e_;
+  }
+#if defined(__AVX2__) && defined(__AVX__)
+  /** Returns the four quads starting at i; i must be a multiple of four. */
+  __m256i block(size_t i) const {
+    const auto x = e_.block(i);
+    return _mm256_xor_si256(x, _mm256_cmpeq_epi64(x, x));
+  }
+#endif
+
+ private:
+  E e_;
+};
+
+/** Bit-wise and. */
+struct BitAndOp {
+  static uint64_t apply(uint64_t x, uint64_t y) {
+    return x & y;
+  }
+  static size_t count(const uint64_t* p, const uint64_t* q, size_t n) {
+    return BitKernels::and_count(p, q, n);
+  }
+  static bool any(const uint64_t* p, const uint64_t* q, size_t n) {
+    return BitKernels::and_any(p, q, n);
+  }
+#if defined(__AVX2__) && defined(__AVX__)
+  static __m256i apply(__m256i x, __m256i y) {
+    return _mm256_and_si256(x, y);
+  }
+#endif
+};
+
+/** Bit-wise or. */
+struct BitOrOp {
+  static uint64_t apply(uint64_t x, uint64_t y) {
+    return x | y;
+  }
+  static size_t count(const uint64_t* p, const uint64_t* q, size_t n) {
+    return BitKernels::or_count(p, q, n);
+  }
+  static bool any(const uint64_t* p, const uint64_t* q, size_t n) {
+    return BitKernels::or_any(p, q, n);
+  }
+#if defined(__AVX2__) && defined(__AVX__)
+  static __m256i apply(__m256i x, __m256i y) {
+    return _mm256_or_si256(x, y);
+  }
+#endif
+};
+
+/** Bit-wise xor. */
+struct BitXorOp {
+  static uint64_t apply(uint64_t x, uint64_t y) {
+    return x ^ y;
+  }
+  static size_t count(const uint64_t* p, const uint64_t* q, size_t n) {
+    return BitKernels::xor_count(p, q, n);
+  }
+  static bool any(const uint64_t* p, const uint64_t* q, size_t n) {
+    return BitKernels::xor_any(p, q, n);
+  }
+#if defined(__AVX2__) && defined(__AVX__)
+  static __m256i apply(__m256i x, __m256i y) {
+    return _mm256_xor_si256(x, y);
+  }
+#endif
+};
+
+/** Bit-wise and. */
+template <typename L, typename R>
+BitBinaryExpr<BitAndOp, typename BitExprOperand<L>::type, typename BitExprOperand<R>::type>
+operator&(const BitExpr<L>& l, const BitExpr<R>& r) {
+  return BitBinaryExpr<BitAndOp, typename BitExprOperand<L>::type, typename BitExprOperand<R>::type>(
+           BitExprOperand<L>::get(l.derived()), BitExprOperand<R>::get(r.derived()));
+}
+
+/** Bit-wise or. */
+template <typename L, typename R>
+BitBinaryExpr<BitOrOp, typename BitExprOperand<L>::type, typename BitExprOperand<R>::type>
+operator|(const BitExpr<L>& l, const BitExpr<R>& r) {
+  return BitBinaryExpr<BitOrOp, typename BitExprOperand<L>::type, typename BitExprOperand<R>::type>(
+           BitExprOperand<L>::get(l.derived()), BitExprOperand<R>::get(r.derived()));
+}
+
+/** Bit-wise xor. */
+template <typename L, typename R>
+BitBinaryExpr<BitXorOp, typename BitExprOperand<L>::type, typename BitExprOperand<R>::type>
+operator^(const BitExpr<L>& l, const BitExpr<R>& r) {
+  return BitBinaryExpr<BitXorOp, typename BitExprOperand<L>::type, typename BitExprOperand<R>::type>(
+           BitExprOperand<L>::get(l.derived()), BitExprOperand<R>::get(r.derived()));
+}
+
+/** Bit-wise not. */
+template <typename E>
+BitNotExpr<typename BitExprOperand<E>::type> operator~(const BitExpr<E>& e) {
+  return BitNotExpr<typename BitExprOperand<E>::type>(BitExprOperand<E>::get(e.derived()));
+}
+
+/** Writes quads [lo, hi) of an expression operand to dst; lo must be a
+ * multiple of four. */
+template <typename E>
+void eval_quads(const E& e, uint64_t* dst, size_t lo, size_t hi) {
+  assert(lo % 4 == 0);
+  auto i = lo;
+
+#if defined(__AVX2__) && defined(__AVX__)
+  for (; i + 4 <= hi; i += 4) {
+    _mm256_store_si256((__m256i*) &dst[i], e.block(i));
+  }
+#endif
+  for (; i < hi; ++i) {
+    dst[i] = e.quad(i);
+  }
+}
+
+/** Returns the number of set bits in quads [lo, hi) of an expression operand;
+ * lo must be a multiple of four. */
+template <typename E>
+size_t count_quads(const E& e, size_t lo, size_t hi) {
+  assert(lo % 4 == 0);
+  auto i = lo;
+  size_t res = 0;
+
+#if defined(__AVX2__) && defined(__AVX__)
+  auto total = _mm256_setzero_si256();
+  for (; i + 4 <= hi; i += 4) {
+    total = _mm256_add_epi64(total, PopCount::block_count(e.block(i)));
+  }
+  res = _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+        _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+#endif
+  for (; i < hi; ++i) {
+    res += BitManip<uint64_t>::pop_count(e.quad(i));
+  }
+  return res;
+}
+
+/** Returns true if any of quads [lo, hi) of an expression operand has a set
+ * bit; lo must be a multiple of four. */
+template <typename E>
+bool any_quads(const E& e, size_t lo, size_t hi) {
+  assert(lo % 4 == 0);
+  auto i = lo;
+
+#if defined(__AVX2__) && defined(__AVX__)
+  for (; i + 4 <= hi; i += 4) {
+    const auto x = e.block(i);
+    if (!_mm256_testz_si256(x, x)) {
+      return true;
+    }
+  }
+#endif
+  for (; i < hi; ++i) {
+    if (e.quad(i)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* An operation on two bit strings, or a bit string and the complement of
+ * another, is reduced by a single dispatched kernel rather than the inline
+ * code above, which is limited to the instruction sets the program was built
+ * for. These overloads are picked over the ones above whenever they match. */
+template <typename Op>
+size_t count_quads(const BitBinaryExpr<Op, BitExprLeaf, BitExprLeaf>& e, size_t lo, size_t hi) {
+  return Op::count(e.left().data() + lo, e.right().data() + lo, hi - lo);
+}
+inline size_t count_quads(const BitBinaryExpr<BitAndOp, BitExprLeaf, BitNotExpr<BitExprLeaf>>& e,
+                          size_t lo, size_t hi) {
+  return BitKernels::andnot_count(e.left().data() + lo, e.right().operand().data() + lo, hi - lo);
+}
+template <typename Op>
+bool any_quads(const BitBinaryExpr<Op, BitExprLeaf, BitExprLeaf>& e, size_t lo, size_t hi) {
+  return Op::any(e.left().data() + lo, e.right().data() + lo, hi - lo);
+}
+inline bool any_quads(const BitBinaryExpr<BitAndOp, BitExprLeaf, BitNotExpr<BitExprLeaf>>& e,
+                      size_t lo, size_t hi) {
+  return BitKernels::andnot_any(e.left().data() + lo, e.right().operand().data() + lo, hi - lo);
+}
+
+/** Returns the number of set bits in an expression without materializing it. */
+template <typename E>
+size_t num_set_bits(const BitExpr<E>& expr) {
+  const auto e = BitExprOperand<E>::get(expr.derived());
+  const auto n = e.num_bits() / 64;
+
+  auto res = count_quads(e, 0, n);
+  if (e.num_bits() % 64) {
+    res += BitManip<uint64_t>::pop_count(e.quad(n) & ((0x1ull << (e.num_bits() % 64)) - 1));
+  }
+
+  return res;
+}
+
+/** Returns true if an expression has any set bits. Stops reading the
+ * operands as soon as one is found. */
+template <typename E>
+bool any_set_bits(const BitExpr<E>& expr) {
+  const auto e = BitExprOperand<E>::get(expr.derived());
+  const auto n = e.num_bits() / 64;
+
+  if (any_quads(e, 0, n)) {
+    return true;
+  }
+  if (e.num_bits() % 64) {
+    return e.quad(n) & ((0x1ull << (e.num_bits() % 64)) - 1);
+  }
+
+  return false;
+}
+
+} // namespace cpputil
+
+#endif
@@ -0,0 +1,362 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_CONTAINER_BIT_LANES_H
+#define CPPUTIL_INCLUDE_CONTAINER_BIT_LANES_H
+
+#include <cassert>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <immintrin.h>
+#include <limits>
+#include <type_traits>
+
+#include "include/container/bit_string.h"
+
+namespace cpputil {
+
+/** Element-wise operations that BitLanes vectorizes. */
+enum class LaneOp : int {
+  ADD,
+  SUB,
+  ADDS,
+  MIN,
+  MAX
+};
+
+#if defined(__AVX2__) && defined(__AVX__)
+
+/* One 256-bit register's worth of lanes of type V. Each specialization says
+ * how many lanes fit, how to apply a LaneOp, how to turn a greater-than
+ * comparison into one bit per lane, and how to fold lanes into partial sums
+ * without overflow. */
+template <typename V>
+struct LaneVec;
+
+/** Shared helpers for the integer lanes. */
+struct LaneVecBase {
+  /** Unsigned greater-than on quads, one mask of ones per lane. */
+  static __m256i gt_u64(__m256i a, __m256i b) {
+    const auto s = _mm256_set1_epi64x(0x8000000000000000ull);
+    return _mm256_cmpgt_epi64(_mm256_xor_si256(a, s), _mm256_xor_si256(b, s));
+  }
+  /** Adds the doubles of x to the quads of acc. */
+  static __m256i widen_u32(__m256i acc, __m256i x) {
+    const auto lo = _mm256_and_si256(x, _mm256_set1_epi64x(0xffffffff));
+    return _mm256_add_epi64(acc, _mm256_add_epi64(lo, _mm256_srli_epi64(x, 32)));
+  }
+};
+
+template <>
+struct LaneVec<uint8_t> : LaneVecBase {
+  enum : size_t { PER = 32 };
+  template <LaneOp O>
+  static __m256i apply(__m256i a, __m256i b) {
+    return O == LaneOp::ADD ? _mm256_add_epi8(a, b) : O == LaneOp::SUB ? _mm256_sub_epi8(a, b) :
+           O == LaneOp::ADDS ? _mm256_adds_epu8(a, b) : O == LaneOp::MIN ? _mm256_min_epu8(a, b) :
+           _mm256_max_epu8(a, b);
+  }
+  static uint64_t gt(__m256i a, __m256i b) {
+    const auto s = _mm256_set1_epi8((char) 0x80);
+    const auto c = _mm256_cmpgt_epi8(_mm256_xor_si256(a, s), _mm256_xor_si256(b, s));
+    return (uint32_t) _mm256_movemask_epi8(c);
+  }
+  static __m256i accumulate(__m256i acc, __m256i x) {
+    return _mm256_add_epi64(acc, _mm256_sad_epu8(x, _mm256_setzero_si256()));
+  }
+};
+
+template <>
+struct LaneVec<uint16_t> : LaneVecBase {
+  enum : size_t { PER = 16 };
+  template <LaneOp O>
+  static __m256i apply(__m256i a, __m256i b) {
+    return O == LaneOp::ADD ? _mm256_add_epi16(a, b) : O == LaneOp::SUB ? _mm256_sub_epi16(a, b) :
+           O == LaneOp::ADDS ? _mm256_adds_epu16(a, b) : O == LaneOp::MIN ? _mm256_min_epu16(a, b) :
+           _mm256_max_epu16(a, b);
+  }
+  /** Packing the comparison against itself leaves each 128-bit half's bits in
+   * the low byte of a pair of bytes of the movemask. */
+  static uint64_t gt(__m256i a, __m256i b) {
+    const auto s = _mm256_set1_epi16((short) 0x8000);
+    const auto c = _mm256_cmpgt_epi16(_mm256_xor_si256(a, s), _mm256_xor_si256(b, s));
+    const auto m = (uint32_t) _mm256_movemask_epi8(_mm256_packs_epi16(c, c));
+    return (m & 0xff) | ((m >> 8) & 0xff00);
+  }
+  static __m256i accumulate(__m256i acc, __m256i x) {
+    const auto lo = _mm256_and_si256(x, _mm256_set1_epi32(0xffff));
+    return widen_u32(acc, _mm256_add_epi32(lo, _mm256_srli_epi32(x, 16)));
+  }
+};
+
+template <>
+struct LaneVec<uint32_t> : LaneVecBase {
+  enum : size_t { PER = 8 };
+  template <LaneOp O>
+  static __m256i apply(__m256i a, __m256i b) {
+    return O == LaneOp::ADD ? _mm256_add_epi32(a, b) : O == LaneOp::SUB ? _mm256_sub_epi32(a, b) :
+           O == LaneOp::ADDS ? adds(a, b) : O == LaneOp::MIN ? _mm256_min_epu32(a, b) :
+           _mm256_max_epu32(a, b);
+  }
+  static uint64_t gt(__m256i a, __m256i b) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(gt_u32(a, b)));
+  }
+  static __m256i accumulate(__m256i acc, __m256i x) {
+    return widen_u32(acc, x);
+  }
+
+ private:
+  static __m256i gt_u32(__m256i a, __m256i b) {
+    const auto s = _mm256_set1_epi32(0x80000000);
+    return _mm256_cmpgt_epi32(_mm256_xor_si256(a, s), _mm256_xor_si256(b, s));
+  }
+  /** A sum that wrapped is smaller than either operand. */
+  static __m256i adds(__m256i a, __m256i b) {
+    const auto s = _mm256_add_epi32(a, b);
+    return _mm256_or_si256(s, gt_u32(a, s));
+  }
+};
+
+template <>
+struct LaneVec<uint64_t> : LaneVecBase {
+  enum : size_t { PER = 4 };
+  template <LaneOp O>
+  static __m256i apply(__m256i a, __m256i b) {
+    return O == LaneOp::ADD ? _mm256_add_epi64(a, b) : O == LaneOp::SUB ? _mm256_sub_epi64(a, b) :
+           O == LaneOp::ADDS ? adds(a, b) :
+           O == LaneOp::MIN ? _mm256_blendv_epi8(a, b, gt_u64(a, b)) :
+           _mm256_blendv_epi8(b, a, gt_u64(a, b));
+  }
+  static uint64_t gt(__m256i a, __m256i b) {
+    return _mm256_movemask_pd(_mm256_castsi256_pd(gt_u64(a, b)));
+  }
+  static __m256i accumulate(__m256i acc, __m256i x) {
+    return _mm256_add_epi64(acc, x);
+  }
+
+ private:
+  /** A sum that wrapped is smaller than either operand. */
+  static __m256i adds(__m256i a, __m256i b) {
+    const auto s = _mm256_add_epi64(a, b);
+    return _mm256_or_si256(s, gt_u64(a, s));
+  }
+};
+
+template <>
+struct LaneVec<float> {
+  enum : size_t { PER = 8 };
+  template <LaneOp O>
+  static __m256i apply(__m256i a, __m256i b) {
+    const auto x = _mm256_castsi256_ps(a);
+    const auto y = _mm256_castsi256_ps(b);
+    return _mm256_castps_si256(O == LaneOp::SUB ? _mm256_sub_ps(x, y) :
+                               O == LaneOp::MIN ? _mm256_min_ps(x, y) :
+                               O == LaneOp::MAX ? _mm256_max_ps(x, y) : _mm256_add_ps(x, y));
+  }
+  static uint64_t gt(__m256i a, __m256i b) {
+    const auto c = _mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _CMP_GT_OQ);
+    return _mm256_movemask_ps(c);
+  }
+  static __m256i accumulate(__m256i acc, __m256i x) {
+    return apply<LaneOp::ADD>(acc, x);
+  }
+};
+
+template <>
+struct LaneVec<double> {
+  enum : size_t { PER = 4 };
+  template <LaneOp O>
+  static __m256i apply(__m256i a, __m256i b) {
+    const auto x = _mm256_castsi256_pd(a);
+    const auto y = _mm256_castsi256_pd(b);
+    return _mm256_castpd_si256(O == LaneOp::SUB ? _mm256_sub_pd(x, y) :
+                               O == LaneOp::MIN ? _mm256_min_pd(x, y) :
+                               O == LaneOp::MAX ? _mm256_max_pd(x, y) : _mm256_add_pd(x, y));
+  }
+  static uint64_t gt(__m256i a, __m256i b) {
+    const auto c = _mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), _CMP_GT_OQ);
+    return _mm256_movemask_pd(c);
+  }
+  static __m256i accumulate(__m256i acc, __m256i x) {
+    return apply<LaneOp::ADD>(acc, x);
+  }
+};
+
+#endif
+
+/* Lane-wise arithmetic on the fixed and float views of bit strings. V picks
+ * the view: uint8_t, uint16_t, uint32_t and uint64_t for fixed bytes, words,
+ * doubles and quads, and float and double for float singles and doubles.
+ * Integer lanes are unsigned and wrap, except under adds(), which saturates.
+ *
+ * With avx2 at compile time, whole registers of lanes are handled at once
+ * with aligned loads, which the 32-byte alignment of every BitString allows;
+ * any lanes left over, and every lane on other builds, are handled one at a
+ * time. Both give the same result, down to the order of floating point
+ * additions in sum(), and to min() and max() returning their second argument
+ * if either is a NaN. */
+template <typename V>
+class BitLanes {
+  static_assert(std::is_arithmetic<V>::value, "BitLanes needs an arithmetic lane type");
+
+ public:
+  /** The result type of sum(): uint64_t for integer lanes, V otherwise. */
+  typedef typename std::conditional<std::is_integral<V>::value, uint64_t, V>::type sum_type;
+
+  /** Returns the number of lanes in a bit string. */
+  template <typename T>
+  static size_t size(const BitString<T>& a) {
+    return a.num_bits() / (8 * sizeof(V));
+  }
+
+  /** Adds the lanes of src to the lanes of dst. */
+  template <typename T, typename U>
+  static void add(BitString<T>& dst, const BitString<U>& src) {
+    apply<LaneOp::ADD>(dst, src);
+  }
+  /** Subtracts the lanes of src from the lanes of dst. */
+  template <typename T, typename U>
+  static void sub(BitString<T>& dst, const BitString<U>& src) {
+    apply<LaneOp::SUB>(dst, src);
+  }
+  /** Adds the lanes of src to the lanes of dst, stopping at the largest value
+   * rather than wrapping around. */
+  template <typename T, typename U>
+  static void adds(BitString<T>& dst, const BitString<U>& src) {
+    static_assert(std::is_integral<V>::value, "Saturating addition needs integer lanes");
+    apply<LaneOp::ADDS>(dst, src);
+  }
+  /** Replaces each lane of dst with the smaller of it and the lane of src. */
+  template <typename T, typename U>
+  static void min(BitString<T>& dst, const BitString<U>& src) {
+    apply<LaneOp::MIN>(dst, src);
+  }
+  /** Replaces each lane of dst with the larger of it and the lane of src. */
+  template <typename T, typename U>
+  static void max(BitString<T>& dst, const BitString<U>& src) {
+    apply<LaneOp::MAX>(dst, src);
+  }
+
+  /** Sets bit i of mask if lane i of a is greater than lane i of b, and unsets
+   * it otherwise; mask must have one bit per lane. */
+  template <typename T, typename U, typename M>
+  static void cmpgt(const BitString<T>& a, const BitString<U>& b, BitString<M>& mask) {
+    assert(a.num_bits() == b.num_bits());
+    assert(mask.num_bits() == size(a));
+    const auto p = (const V*) a.data();
+    const auto q = (const V*) b.data();
+    const auto m = (uint64_t*) mask.data();
+    const auto n = size(a);
+
+    uint64_t bits = 0;
+    size_t i = 0;
+#if defined(__AVX2__) && defined(__AVX__)
+    for (; i + LaneVec<V>::PER <= n; i += LaneVec<V>::PER) {
+      bits |= LaneVec<V>::gt(load(p + i), load(q + i)) << (i % 64);
+      if ((i + LaneVec<V>::PER) % 64 == 0) {
+        m[i / 64] = bits;
+        bits = 0;
+      }
+    }
+#endif
+    for (; i < n; ++i) {
+      bits |= (uint64_t)(p[i] > q[i]) << (i % 64);
+      if ((i + 1) % 64 == 0) {
+        m[i / 64] = bits;
+        bits = 0;
+      }
+    }
+    if (n % 64) {
+      m[n / 64] = bits;
+    }
+  }
+
+  /** Returns the sum of the lanes of a. Integer lanes are summed in 64 bits,
+   * and float lanes in one partial sum per lane of a register. */
+  template <typename T>
+  static sum_type sum(const BitString<T>& a) {
+    const auto p = (const V*) a.data();
+    const auto n = size(a);
+
+    sum_type part[PER] = {};
+    size_t i = 0;
+#if defined(__AVX2__) && defined(__AVX__)
+    auto acc = _mm256_setzero_si256();
+    for (; i + PER <= n; i += PER) {
+      acc = LaneVec<V>::accumulate(acc, load(p + i));
+    }
+    _mm256_storeu_si256((__m256i*) part, acc);
+#else
+    for (; i + PER <= n; i += PER) {
+      for (size_t j = 0; j < PER; ++j) {
+        part[j] += p[i + j];
+      }
+    }
+#endif
+    sum_type res = 0;
+    for (size_t j = 0; j < PER; ++j) {
+      res += part[j];
+    }
+    for (; i < n; ++i) {
+      res += p[i];
+    }
+    return res;
+  }
+
+ private:
+  /** The number of lanes in 256 bits. */
+  enum : size_t {
+    PER = 32 / sizeof(V)
+  };
+
+#if defined(__AVX2__) && defined(__AVX__)
+  /** Loads a register of lanes. */
+  static __m256i load(const V* p) {
+    assert((uintptr_t) p % 32 == 0);
+    return _mm256_load_si256((const __m256i*) p);
+  }
+#endif
+
+  /** Applies an operation to a pair of lanes. */
+  template <LaneOp O>
+  static V apply(V a, V b) {
+    return O == LaneOp::ADD ? (V)(a + b) : O == LaneOp::SUB ? (V)(a - b) :
+           O == LaneOp::ADDS ? ((V)(a + b) < a ? std::numeric_limits<V>::max() : (V)(a + b)) :
+           O == LaneOp::MIN ? (a < b ? a : b) : (a > b ? a : b);
+  }
+  /** Applies an operation to every pair of lanes. */
+  template <LaneOp O, typename T, typename U>
+  static void apply(BitString<T>& dst, const BitString<U>& src) {
+    assert(dst.num_bits() == src.num_bits());
+    const auto p = (V*) dst.data();
+    const auto q = (const V*) src.data();
+    const auto n = size(dst);
+
+    size_t i = 0;
+#if defined(__AVX2__) && defined(__AVX__)
+    for (; i + PER <= n; i += PER) {
+      const auto x = LaneVec<V>::template apply<O>(load(p + i), load(q + i));
+      _mm256_store_si256((__m256i*)(p + i), x);
+    }
+#endif
+    for (; i < n; ++i) {
+      p[i] = apply<O>(p[i], q[i]);
+    }
+  }
+};
+
+} // namespace cpputil
+
+#endif
@@ -0,0 +1,153 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_CONTAINER_BIT_MATRIX_H
+#define CPPUTIL_INCLUDE_CONTAINER_BIT_MATRIX_H
+
+#include <cassert>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "include/bits/bit_transpose.h"
+#include "include/container/bit_string.h"
+#include "include/container/bit_vector.h"
+
+namespace cpputil {
+
+/* A matrix of bits, stored row by row in a BitVector. Every row starts on a
+ * quad, and the rows are padded with zero rows to a multiple of 64, so the
+ * matrix is a grid of 64x64 blocks that BitTranspose works on directly. The
+ * bits past the last column of a row are always zero. */
+class BitMatrix {
+ public:
+  /** Creates an empty matrix. */
+  BitMatrix() : BitMatrix(0, 0) { }
+  /** Creates a matrix of zeros with the given dimensions. */
+  BitMatrix(size_t rows, size_t cols) :
+    num_rows_(rows), num_cols_(cols), stride_((cols + 63) / 64),
+    bits_(64 * stride_ * 64 * ((rows + 63) / 64)) { }
+
+  /** Returns the number of rows. */
+  size_t num_rows() const {
+    return num_rows_;
+  }
+  /** Returns the number of columns. */
+  size_t num_cols() const {
+    return num_cols_;
+  }
+
+  /** Returns a bit. */
+  BitVector::bit_type get_bit(size_t r, size_t c) {
+    assert(r < num_rows_);
+    assert(c < num_cols_);
+    return bits_.get_bit(64 * stride_ * r + c);
+  }
+  /** Returns a const bool value. */
+  bool get_bit(size_t r, size_t c) const {
+    assert(r < num_rows_);
+    assert(c < num_cols_);
+    return bits_.get_bit(64 * stride_ * r + c);
+  }
+
+  /** Copies a bit string of num_cols() bits into a row. */
+  template <typename T>
+  void set_row(size_t r, const BitString<T>& row) {
+    assert(r < num_rows_);
+    assert(row.num_bits() == num_cols_);
+    const auto p = (const uint64_t*) row.data();
+    std::copy(p, p + stride_, quads() + r * stride_);
+    if (num_cols_ % 64) {
+      quads()[(r + 1) * stride_ - 1] &= (0x1ull << (num_cols_ % 64)) - 1;
+    }
+  }
+  /** Copies a row into a bit string of num_cols() bits. */
+  template <typename T>
+  void get_row(size_t r, BitString<T>& row) const {
+    assert(r < num_rows_);
+    assert(row.num_bits() == num_cols_);
+    const auto p = quads() + r * stride_;
+    std::copy(p, p + stride_, (uint64_t*) row.data());
+  }
+  /** Copies a column into a bit string of num_rows() bits, 64 rows at a
+   * time. */
+  template <typename T>
+  void get_column(size_t c, BitString<T>& col) const {
+    assert(c < num_cols_);
+    assert(col.num_bits() == num_rows_);
+    const auto g = BitTranspose::gather();
+    const auto p = (uint64_t*) col.data();
+    for (size_t i = 0, ie = (num_rows_ + 63) / 64; i < ie; ++i) {
+      p[i] = g(quads() + 64 * i * stride_ + c / 64, stride_, c % 64);
+    }
+  }
+
+  /** Returns the transpose of this matrix. */
+  BitMatrix transpose() const {
+    BitMatrix res(num_cols_, num_rows_);
+    transpose_into(res);
+    return res;
+  }
+  /** Writes the transpose of this matrix to res, which must have num_cols()
+   * rows and num_rows() columns. Whole 256x256 tiles are transposed together
+   * for locality, and the blocks along the edges one at a time. */
+  void transpose_into(BitMatrix& res) const {
+    assert(res.num_rows_ == num_cols_);
+    assert(res.num_cols_ == num_rows_);
+    const auto rb = (num_rows_ + 63) / 64;
+    const auto cb = stride_;
+    const auto src = quads();
+    const auto dst = res.quads();
+    const auto k = BitTranspose::kernel();
+
+    for (size_t i = 0; i < rb; i += 4) {
+      for (size_t j = 0; j < cb; j += 4) {
+        if (i + 4 <= rb && j + 4 <= cb) {
+          BitTranspose::transpose_256(src + 64 * i * stride_ + j, stride_,
+                                      dst + 64 * j * rb + i, rb);
+          continue;
+        }
+        for (size_t ii = i; ii < std::min(i + 4, rb); ++ii) {
+          for (size_t jj = j; jj < std::min(j + 4, cb); ++jj) {
+            k(src + 64 * ii * stride_ + jj, stride_, dst + 64 * jj * rb + ii, rb);
+          }
+        }
+      }
+    }
+  }
+
+  /** Returns the bits of this matrix, row by row, including the padding. */
+  const BitVector& bits() const {
+    return bits_;
+  }
+
+ private:
+  size_t num_rows_;
+  size_t num_cols_;
+  size_t stride_;
+  BitVector bits_;
+
+  /** Returns the quads of this matrix. */
+  uint64_t* quads() {
+    return (uint64_t*) bits_.data();
+  }
+  /** Returns the quads of this matrix. */
+  const uint64_t* quads() const {
+    return (const uint64_t*) bits_.data();
+  }
+};
+
+} // namespace cpputil
+
+#endif
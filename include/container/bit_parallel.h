@@ -0,0 +1,152 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_CONTAINER_BIT_PARALLEL_H
+#define CPPUTIL_INCLUDE_CONTAINER_BIT_PARALLEL_H
+
+#include <cassert>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "include/bits/bit_manip.h"
+#include "include/container/bit_expr.h"
+#include "include/container/bit_string.h"
+#include "include/patterns/singleton.h"
+#include "include/system/thread_pool.h"
+
+namespace cpputil {
+
+/* An opt-in policy for running bulk bit string operations on a thread pool.
+ * Each operation splits its quads into one range per thread. Ranges start
+ * on cache line boundaries, so no two threads ever write the same line.
+ * Operations on fewer bytes than the threshold run on the calling thread,
+ * since waking the pool costs more than it saves.
+ *
+ *   BitParallel par;
+ *   par.assign(b1, b1 | b2);
+ *   const auto n = par.num_set_bits(b1 ^ b3);
+ */
+class BitParallel {
+ public:
+  enum : size_t {
+    /** The default number of bytes below which operations run serially. */
+    THRESHOLD = 1 << 22
+  };
+
+  /** Creates a policy that runs operations on a shared pool with one thread
+   * per core. */
+  BitParallel() : pool_(Singleton<ThreadPool>::get()), threshold_(THRESHOLD) { }
+  /** Creates a policy that runs operations on a given pool. */
+  explicit BitParallel(ThreadPool& pool, size_t threshold = THRESHOLD) :
+    pool_(pool), threshold_(threshold) { }
+
+  /** Returns the pool that operations run on. */
+  ThreadPool& pool() const {
+    return pool_;
+  }
+  /** Returns the number of bytes below which operations run serially. */
+  size_t threshold() const {
+    return threshold_;
+  }
+
+  /** Evaluates an expression into dst; covers and, or, xor and not. */
+  template <typename T, typename E>
+  BitString<T>& assign(BitString<T>& dst, const BitExpr<E>& rhs) const {
+    const auto e = BitExprOperand<E>::get(rhs.derived());
+    assert(e.num_bits() == dst.num_bits());
+
+    const auto n = dst.num_bits();
+    const auto p = (uint64_t*) dst.data();
+    partition(p, (n + 63) / 64, [&e, p](size_t lo, size_t hi, size_t) {
+      eval_quads(e, p, lo, hi);
+    });
+    if (n % 64) {
+      p[n / 64] &= (0x1ull << (n % 64)) - 1;
+    }
+    return dst;
+  }
+  /** Copies src into dst. */
+  template <typename T>
+  BitString<T>& copy(BitString<T>& dst, const BitString<T>& src) const {
+    return assign(dst, src);
+  }
+  /** Sets every bit of dst to val. */
+  template <typename T>
+  BitString<T>& fill(BitString<T>& dst, bool val) const {
+    const auto n = dst.num_bits();
+    partition(dst.data(), (n + 63) / 64, [&dst, n, val](size_t lo, size_t hi, size_t) {
+      if (val) {
+        dst.set_range(64 * lo, std::min(64 * hi, n));
+      } else {
+        dst.reset_range(64 * lo, std::min(64 * hi, n));
+      }
+    });
+    return dst;
+  }
+
+  /** Returns the number of set bits in an expression. */
+  template <typename E>
+  size_t num_set_bits(const BitExpr<E>& expr) const {
+    const auto e = BitExprOperand<E>::get(expr.derived());
+    const auto n = e.num_bits() / 64;
+
+    std::vector<size_t> counts(pool_.num_threads(), 0);
+    partition(nullptr, n, [&e, &counts](size_t lo, size_t hi, size_t part) {
+      counts[part] = count_quads(e, lo, hi);
+    });
+
+    size_t res = 0;
+    for (auto c : counts) {
+      res += c;
+    }
+    if (e.num_bits() % 64) {
+      res += BitManip<uint64_t>::pop_count(e.quad(n) & ((0x1ull << (e.num_bits() % 64)) - 1));
+    }
+    return res;
+  }
+
+ private:
+  ThreadPool& pool_;
+  size_t threshold_;
+
+  /** Calls f(lo, hi, i) on the i'th of at most one range of quads per
+   * thread. The ranges are disjoint and cover [0, n). Given quads that
+   * start at base, which must be 32-byte aligned, every range but the first
+   * starts on a cache line boundary. */
+  template <typename F>
+  void partition(const void* base, size_t n, F f) const {
+    const auto threads = pool_.num_threads();
+    if (8 * n < threshold_ || threads == 1) {
+      f(0, n, 0);
+      return;
+    }
+
+    // The boundaries are pulled back by the offset of base into its cache line
+    const auto skew = ((uintptr_t) base % 64) / 8;
+    const auto step = std::max((size_t) 8, ((n + skew + threads - 1) / threads + 7) / 8 * 8);
+    pool_.run(threads, [n, skew, step, &f](size_t i) {
+      const auto lo = i == 0 ? 0 : std::min(n, i * step - skew);
+      const auto hi = std::min(n, (i + 1) * step - skew);
+      if (lo < hi) {
+        f(lo, hi, i);
+      }
+    });
+  }
+};
+
+} // namespace cpputil
+
+#endif
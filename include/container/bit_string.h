@@ -20,15 +20,21 @@
 
 #include <algorithm>
 #include <array>
+#include <functional>
 #include <immintrin.h>
 #include <xmmintrin.h>
 
+#include "include/bits/bit_decode.h"
+#include "include/bits/bit_kernels.h"
 #include "include/bits/bit_manip.h"
+#include "include/bits/bulk_copy.h"
+#include "include/bits/pop_count.h"
+#include "include/container/bit_expr.h"
 
 namespace cpputil {
 
 template <typename T>
-class BitString {
+class BitString : public BitExpr<BitString<T>> {
  public:
 
   /* This class iterates through the indexes of the set bits in a bit string.
@@ -115,6 +121,112 @@ class BitString {
     uint64_t current_;
   };
 
+  /** A contiguous range of set bit indices. */
+  class set_bit_index_batch {
+    friend class BitString;
+
+   public:
+    /** Returns the first index in the batch. */
+    const uint32_t* begin() const {
+      return begin_;
+    }
+    /** Returns one past the last index in the batch. */
+    const uint32_t* end() const {
+      return end_;
+    }
+    /** Returns the number of indices in the batch. */
+    size_t size() const {
+      return end_ - begin_;
+    }
+
+   private:
+    /** Constructor. */
+    set_bit_index_batch(const uint32_t* begin, const uint32_t* end) : begin_(begin), end_(end) { }
+
+    const uint32_t* begin_;
+    const uint32_t* end_;
+  };
+
+  /* This class iterates through the indexes of the set bits in a bit string a
+   * batch at a time. Each batch holds the indexes of the set bits in one
+   * non-empty 256-bit block, decoded in bulk by BitDecode. Empty blocks are
+   * skipped without being decoded. A batch is only valid until the iterator
+   * that produced it is incremented. */
+  class const_set_bit_index_batch_iterator {
+    friend class BitString;
+
+   public:
+    /** Return the current batch. */
+    set_bit_index_batch operator*() const {
+      return set_bit_index_batch(buf_, buf_ + size_);
+    }
+    /** Increment. */
+    const_set_bit_index_batch_iterator& operator++() {
+      i_ += 4;
+      next();
+      return *this;
+    }
+    /** Equality. */
+    bool operator==(const const_set_bit_index_batch_iterator& rhs) const {
+      return i_ == rhs.i_;
+    }
+    /** Inequality. */
+    bool operator!=(const const_set_bit_index_batch_iterator& rhs) const {
+      return i_ != rhs.i_;
+    }
+
+   private:
+    /** Constructor. */
+    const_set_bit_index_batch_iterator(const uint64_t* data, size_t i, size_t num_bits) :
+      data_(data), i_(i), num_bits_(num_bits), size_(0), decode_(BitDecode::kernel()) {
+      assert(num_bits_ <= 0x100000000ull);
+      next();
+    }
+
+    /** Moves i_ to the next non-empty block at or after i_ and decodes it. */
+    void next() {
+      const auto n = (num_bits_ + 63) / 64;
+      const auto full = num_bits_ / 64;
+
+      for (; i_ < n; i_ += 4) {
+        if (i_ + 4 <= full) {
+          if ((data_[i_] | data_[i_ + 1] | data_[i_ + 2] | data_[i_ + 3]) == 0) {
+            continue;
+          }
+          size_ = decode_(data_ + i_, 4, 64 * i_, buf_);
+          return;
+        }
+
+        /* The last block may be short or end in a partial quad */
+        uint64_t last[4] = {0, 0, 0, 0};
+        std::copy(data_ + i_, data_ + n, last);
+        if (num_bits_ % 64) {
+          last[full - i_] &= (0x1ull << (num_bits_ % 64)) - 1;
+        }
+        size_ = BitDecode::scalar(last, 4, 64 * i_, buf_);
+        if (size_ > 0) {
+          return;
+        }
+      }
+
+      i_ = (n + 3) / 4 * 4;
+      size_ = 0;
+    }
+
+    /* The quads of the bit string, and the index of the first quad in the
+     * current block */
+    const uint64_t* data_;
+    size_t i_;
+
+    /* The total number of bits available */
+    size_t num_bits_;
+
+    /* The decoded indexes of the current block */
+    size_t size_;
+    BitDecode::kernel_type decode_;
+    uint32_t buf_[256 + BitDecode::SLACK];
+  };
+
   template <typename S>
   class const_set_index_iterator {
     friend class BitString;
@@ -127,7 +239,7 @@ class BitString {
     /** Increment. */
     const_set_index_iterator& operator++() {
       const auto old_itr = itr_;
-      for (++itr_; itr_ != end_ && *itr_ == 0; ++itr_);
+      itr_ = BitDecode::next_nonzero(itr_ + 1, end_);
       index_ += (itr_ - old_itr);
 			return *this;
     }
@@ -143,7 +255,7 @@ class BitString {
    private:
     /** Constructor. */
     const_set_index_iterator(const S* itr, const S* begin, const S* end) : end_(end) {
-      for (itr_ = itr; itr_ != end_ && *itr_ == 0; ++itr_);
+      itr_ = BitDecode::next_nonzero(itr, end_);
       index_ = itr_ - begin;
     }
 
@@ -199,14 +311,12 @@ class BitString {
   /** Default constructor. */
   BitString() : contents_(), num_bits_(0) { }
   /** Copy constructor. */
-  BitString(const BitString& rhs) {
-    contents_ = rhs.contents_;
-    num_bits_ = rhs.num_bits_;
-  }
+  BitString(const BitString& rhs) :
+    BitExpr<BitString<T>>(), contents_(rhs.contents_), num_bits_(rhs.num_bits_) { }
   /** Move constructor. */
-  BitString(BitString&& rhs) {
-    contents_ = std::move(rhs.contents_);
-    num_bits_ = rhs.num_bits_;
+  BitString(BitString&& rhs) :
+    BitExpr<BitString<T>>(), contents_(std::move(rhs.contents_)), num_bits_(rhs.num_bits_) {
+    rhs.num_bits_ = 0;
   }
   /** Assignment operator. */
   BitString& operator=(const BitString& rhs) {
@@ -214,10 +324,21 @@ class BitString {
     return *this;
   }
   /** Move assignment operator. */
-  BitString& operator=(const BitString && rhs) {
+  BitString& operator=(BitString&& rhs) {
     BitString(std::move(rhs)).swap(*this);
     return *this;
   }
+  /** Expression assignment; evaluates rhs in a single pass. The bits past
+   * the end of the string are left unset. */
+  template <typename E>
+  BitString& operator=(const BitExpr<E>& rhs) {
+    const auto e = BitExprOperand<E>::get(rhs.derived());
+    assert(e.num_bits() == num_bits_);
+
+    eval_quads(e, (uint64_t*) contents_.data(), 0, (num_bits_ + 63) / 64);
+    mask_tail();
+    return *this;
+  }
 
   /** Returns the number of bits in this string. */
   size_t num_bits() const {
@@ -250,8 +371,59 @@ class BitString {
 
 	/** Returns the number of set bits in this string. */
 	size_t num_set_bits() const {
-		assert(false);
-		return 0;
+		const auto n = num_bits_ / 64;
+		auto count = PopCount::count((const uint64_t*) contents_.data(), n);
+		if (num_bits_ % 64) {
+			count += BitManip<uint64_t>::pop_count(contents_[n] & ((0x1ull << (num_bits_ % 64)) - 1));
+		}
+		return count;
+	}
+	/** Writes the index of every set bit in this string to out, in increasing
+	 * order, and returns the number of indices written; out must have room for
+	 * num_set_bits() indices. Dense strings decode several times faster this
+	 * way than through a set bit index iterator. */
+	size_t decode_set_bits(uint32_t* out) const {
+		assert(num_bits_ <= 0x100000000ull);
+		const auto p = (const uint64_t*) contents_.data();
+		const auto n = num_bits_ / 64;
+
+		// The vector kernels write past the last index they return, so the last
+		// few set bits are decoded one at a time
+		auto split = n;
+		for (size_t tail = 0; split > 0 && tail < BitDecode::SLACK; --split) {
+			tail += BitManip<uint64_t>::pop_count(p[split - 1]);
+		}
+		auto count = BitDecode::decode(p, split, 0, out);
+		count += BitDecode::scalar(p + split, n - split, 64 * split, out + count);
+		if (num_bits_ % 64) {
+			const uint64_t last = p[n] & ((0x1ull << (num_bits_ % 64)) - 1);
+			count += BitDecode::scalar(&last, 1, 64 * n, out + count);
+		}
+		return count;
+	}
+	/** Writes the index of every set byte in this string to out, in increasing
+	 * order, and returns the number of indices written; out must have room for
+	 * num_set_bytes() indices. */
+	size_t decode_set_bytes(uint32_t* out) const {
+		return BitDecode::decode_nonzero(fixed_byte_begin(), num_fixed_bytes(), out);
+	}
+	/** Writes the index of every set word in this string to out, in increasing
+	 * order, and returns the number of indices written; out must have room for
+	 * num_set_words() indices. */
+	size_t decode_set_words(uint32_t* out) const {
+		return BitDecode::decode_nonzero(fixed_word_begin(), num_fixed_words(), out);
+	}
+	/** Writes the index of every set double in this string to out, in
+	 * increasing order, and returns the number of indices written; out must
+	 * have room for num_set_doubles() indices. */
+	size_t decode_set_doubles(uint32_t* out) const {
+		return BitDecode::decode_nonzero(fixed_double_begin(), num_fixed_doubles(), out);
+	}
+	/** Writes the index of every set quad in this string to out, in increasing
+	 * order, and returns the number of indices written; out must have room for
+	 * num_set_quads() indices. */
+	size_t decode_set_quads(uint32_t* out) const {
+		return BitDecode::decode_nonzero(fixed_quad_begin(), num_fixed_quads(), out);
 	}
 	/** Returns the number of set bytes in this string. */
 	size_t num_set_bytes() const {
@@ -368,6 +540,16 @@ class BitString {
                                         num_bits());
   }
 
+  /** Set bit index batch iterator. */
+  const_set_bit_index_batch_iterator set_bit_index_batch_begin() const {
+    return const_set_bit_index_batch_iterator((const uint64_t*) contents_.data(), 0, num_bits());
+  }
+  /** Set bit index batch iterator. */
+  const_set_bit_index_batch_iterator set_bit_index_batch_end() const {
+    return const_set_bit_index_batch_iterator((const uint64_t*) contents_.data(),
+           (num_bits() + 255) / 256 * 4, num_bits());
+  }
+
   /** Set byte index iterator. */
   const_set_byte_index_iterator set_byte_index_begin() const {
     return const_set_byte_index_iterator(fixed_byte_begin(), fixed_byte_begin(), fixed_byte_end());
@@ -508,144 +690,162 @@ class BitString {
     return (double*) contents_.data() + num_float_doubles();
   }
 
-	/** Bit-wise block copy */
-	BitString& copy(const BitString& rhs) {
-    size_t i = 0;
-
-#if defined(__AVX2__) && defined(__AVX__)
-    for (; i + 4 <= contents_.size(); i += 4) {
-      auto x = _mm256_load_si256((__m256i*) &rhs.contents_[i]);
-      _mm256_store_si256((__m256i*) &contents_[i], x);
-    }
-#elif defined(__AVX__)
-    for (; i + 2 <= contents_.size(); i += 2) {
-      auto x = _mm_load_si128((__m128i*) &rhs.contents_[i]);
-      _mm_store_si128((__m128i*)&contents_[i], x);
-    }
-#endif
-    for (; i < contents_.size(); ++i) {
-      contents_[i] = rhs.contents_[i];
-    }
-
-    return *this;
+	/** Bit-wise block copy. Large copies stream past the cache unless mode
+	 * says otherwise. */
+	BitString& copy(const BitString& rhs, StoreMode mode = StoreMode::AUTO) {
+		BulkCopy::copy((uint64_t*) contents_.data(), (const uint64_t*) rhs.contents_.data(),
+		               contents_.size(), mode);
+		return *this;
 	}
 
   /** Bit-wise and. */
   BitString& operator&=(const BitString& rhs) {
-    size_t i = 0;
+    BitKernels::and_into((uint64_t*) contents_.data(), (const uint64_t*) rhs.contents_.data(),
+                         contents_.size());
+    return *this;
+  }
 
-#if defined(__AVX2__) && defined(__AVX__)
-    for (; i + 4 <= contents_.size(); i += 4) {
-      auto x = _mm256_load_si256((__m256i*) &contents_[i]);
-      auto y = _mm256_load_si256((__m256i*) &rhs.contents_[i]);
-      x = _mm256_and_si256(x, y);
-      _mm256_store_si256((__m256i*)&contents_[i], x);
-    }
-#elif defined(__AVX__)
-    for (; i + 2 <= contents_.size(); i += 2) {
-      auto x = _mm_load_si128((__m128i*) &contents_[i]);
-      auto y = _mm_load_si128((__m128i*) &rhs.contents_[i]);
-      x = _mm_and_si128(x, y);
-      _mm_store_si128((__m128i*)&contents_[i], x);
-    }
-#endif
-    for (; i < contents_.size(); ++i) {
-      contents_[i] &= rhs.contents_[i];
-    }
+  /** Bit-wise or. */
+  BitString& operator|=(const BitString& rhs) {
+    BitKernels::or_into((uint64_t*) contents_.data(), (const uint64_t*) rhs.contents_.data(),
+                        contents_.size());
+    return *this;
+  }
 
+  /** Bit-wise xor. */
+  BitString& operator^=(const BitString& rhs) {
+    BitKernels::xor_into((uint64_t*) contents_.data(), (const uint64_t*) rhs.contents_.data(),
+                         contents_.size());
     return *this;
   }
-  /** Bit-wise and. */
-  BitString operator&(const BitString& rhs) const {
-    auto ret = *this;
-    return ret += rhs;
+
+  /** Bit-wise and with an expression. */
+  template <typename E>
+  BitString& operator&=(const BitExpr<E>& rhs) {
+    return *this = *this & rhs;
   }
-  /** Bit-wise and. */
-  BitString operator&(BitString&& rhs) const {
-    auto ret = BitString(std::move(rhs));
-    return ret += *this;
+  /** Bit-wise or with an expression. */
+  template <typename E>
+  BitString& operator|=(const BitExpr<E>& rhs) {
+    return *this = *this | rhs;
+  }
+  /** Bit-wise xor with an expression. */
+  template <typename E>
+  BitString& operator^=(const BitExpr<E>& rhs) {
+    return *this = *this ^ rhs;
   }
 
-  /** Bit-wise or. */
-  BitString& operator|=(const BitString& rhs) {
-    size_t i = 0;
-
-#if defined(__AVX2__) && defined(__AVX__)
-    for (; i + 4 <= contents_.size() ; i += 4) {
-      auto x = _mm256_load_si256((__m256i*) &contents_[i]);
-      auto y = _mm256_load_si256((__m256i*) &rhs.contents_[i]);
-      x = _mm256_or_si256(x, y);
-      _mm256_store_si256((__m256i*)&contents_[i], x);
-    }
-#elif defined(__AVX__)
-    for (; i + 2 <= contents_.size() ; i += 2) {
-      auto x = _mm_load_si128((__m128i*) &contents_[i]);
-      auto y = _mm_load_si128((__m128i*) &rhs.contents_[i]);
-      x = _mm_or_si128(x, y);
-      _mm_store_si128((__m128i*)&contents_[i], x);
-    }
-#endif
-    for (; i < contents_.size(); ++i) {
-      contents_[i] |= rhs.contents_[i];
+  /** Flips every bit in place. The bits past the end of the string stay
+   * unset. */
+  BitString& flip() {
+    const auto p = (uint64_t*) contents_.data();
+    BitKernels::not_into(p, p, (num_bits_ + 63) / 64, false);
+    mask_tail();
+    return *this;
+  }
+  /** Writes the complement of this string to dst, which must be the same
+   * length; the bits past the end of dst are left unset. Large strings are
+   * written with streaming stores unless mode says otherwise. */
+  template <typename U>
+  void not_into(BitString<U>& dst, StoreMode mode = StoreMode::AUTO) const {
+    assert(dst.num_bits() == num_bits_);
+    const auto n = (num_bits_ + 63) / 64;
+    const auto p = (uint64_t*) dst.data();
+    BitKernels::not_into(p, (const uint64_t*) contents_.data(), n, BulkCopy::streams(mode, 8 * n));
+    if (num_bits_ % 64) {
+      p[n - 1] &= low_mask(num_bits_ % 64);
     }
+  }
 
-    return *this;
+  /** Sets the bits in [lo, hi). */
+  BitString& set_range(size_t lo, size_t hi) {
+    return apply_range<BitOrOp>(lo, hi, false);
   }
-  /** Bit-wise or. */
-  BitString operator|(const BitString& rhs) const {
-    auto ret = *this;
-    return ret |= rhs;
+  /** Unsets the bits in [lo, hi). */
+  BitString& reset_range(size_t lo, size_t hi) {
+    return apply_range<BitAndOp>(lo, hi, true);
   }
-  /** Bit-wise or. */
-  BitString operator|(BitString&& rhs) const {
-    auto ret = BitString(std::move(rhs));
-    return ret |= *this;
+  /** Flips the bits in [lo, hi). */
+  BitString& flip_range(size_t lo, size_t hi) {
+    return apply_range<BitXorOp>(lo, hi, false);
   }
 
-  /** Bit-wise xor. */
-  BitString& operator^=(const BitString& rhs) {
-    size_t i = 0;
+  /** Copies the len bits of src that start at src_off to the len bits of this
+   * string that start at dst_off. src may be this string, in which case the
+   * ranges may overlap. Bits are moved a quad at a time, with each quad
+   * assembled from the two source quads that it straddles. */
+  BitString& copy_bits(const BitString& src, size_t src_off, size_t dst_off, size_t len) {
+    assert(src_off + len <= src.num_bits_);
+    assert(dst_off + len <= num_bits_);
+    if (len == 0) {
+      return *this;
+    }
 
-#if defined(__AVX2__) && defined(__AVX__)
-    for (; i + 4 <= contents_.size() ; i += 4) {
-      auto x = _mm256_load_si256((__m256i*) &contents_[i]);
-      auto y = _mm256_load_si256((__m256i*) &rhs.contents_[i]);
-      x = _mm256_xor_si256(x, y);
-      _mm256_store_si256((__m256i*)&contents_[i], x);
+    const auto sp = (const uint64_t*) src.contents_.data();
+    const auto dp = (uint64_t*) contents_.data();
+    const auto head = std::min(len, (64 - dst_off % 64) % 64);
+    const auto body = (len - head) / 64 * 64;
+    const auto tail = len - head - body;
+
+    // An overlapping copy to a higher offset has to run backwards
+    if (sp == dp && dst_off > src_off && dst_off < src_off + len) {
+      if (tail) {
+        write_bits(dp, dst_off + head + body, tail, read_bits(sp, src_off + head + body, tail));
+      }
+      for (auto i = head + body; i > head; i -= 64) {
+        dp[(dst_off + i) / 64 - 1] = read_bits(sp, src_off + i - 64, 64);
+      }
+      if (head) {
+        write_bits(dp, dst_off, head, read_bits(sp, src_off, head));
+      }
+      return *this;
     }
-#elif defined(__AVX__)
-    for (; i + 2 <= contents_.size() ; i += 2) {
-      auto x = _mm_load_si128((__m128i*) &contents_[i]);
-      auto y = _mm_load_si128((__m128i*) &rhs.contents_[i]);
-      x = _mm_xor_si128(x, y);
-      _mm_store_si128((__m128i*)&contents_[i], x);
+
+    if (head) {
+      write_bits(dp, dst_off, head, read_bits(sp, src_off, head));
+    }
+
+    size_t i = head;
+#if defined(__AVX2__) && defined(__AVX__)
+    // Each block reads one quad past the four that it covers
+    const auto src_quads = (src.num_bits_ + 63) / 64;
+    const auto shl = _mm_cvtsi64_si128((src_off + i) % 64);
+    const auto shr = _mm_cvtsi64_si128(64 - (src_off + i) % 64);
+    for (; i + 256 <= head + body && (src_off + i) / 64 + 5 <= src_quads; i += 256) {
+      const auto q = (src_off + i) / 64;
+      const auto lo = _mm256_loadu_si256((const __m256i*)(sp + q));
+      const auto hi = _mm256_loadu_si256((const __m256i*)(sp + q + 1));
+      const auto x = _mm256_or_si256(_mm256_srl_epi64(lo, shl), _mm256_sll_epi64(hi, shr));
+      _mm256_storeu_si256((__m256i*)(dp + (dst_off + i) / 64), x);
     }
 #endif
-    for (; i < contents_.size(); ++i) {
-      contents_[i] ^= rhs.contents_[i];
+    for (; i < head + body; i += 64) {
+      dp[(dst_off + i) / 64] = read_bits(sp, src_off + i, 64);
     }
 
+    if (tail) {
+      write_bits(dp, dst_off + i, tail, read_bits(sp, src_off + i, tail));
+    }
     return *this;
   }
-  /** Bit-wise xor. */
-  BitString operator^(const BitString& rhs) const {
-    auto ret = *this;
-    return ret ^= rhs;
-  }
-  /** Bit-wise xor. */
-  BitString operator^(BitString&& rhs) const {
-    auto ret = BitString(std::move(rhs));
-    return ret ^= *this;
-  }
-  /** Bit-wise not. */
-  BitString operator~() const {
-    // Any good ideas for how to vectorize this effectively?
 
-    auto ret = *this;
-    for (size_t i = 0; i < contents_.size(); ++i) {
-      ret.contents_[i] = ~contents_[i];
+  /** Moves every bit to an index n higher. The lowest n bits are unset, and
+   * bits moved past the end of the string are lost. */
+  BitString& operator<<=(size_t n) {
+    if (n >= num_bits_) {
+      return reset_range(0, num_bits_);
+    }
+    copy_bits(*this, 0, n, num_bits_ - n);
+    return reset_range(0, n);
+  }
+  /** Moves every bit to an index n lower. The highest n bits are unset, and
+   * bits moved past the beginning of the string are lost. */
+  BitString& operator>>=(size_t n) {
+    if (n >= num_bits_) {
+      return reset_range(0, num_bits_);
     }
-    return ret;
+    copy_bits(*this, n, 0, num_bits_ - n);
+    return reset_range(num_bits_ - n, num_bits_);
   }
 
   /** Underlying data. */
@@ -666,13 +866,52 @@ class BitString {
     return get_bit(i);
   }
 
+  /** Returns the number of bits set in both this and rhs. */
+  size_t intersect_count(const BitString& rhs) const {
+    return cpputil::num_set_bits(*this & rhs);
+  }
+  /** Returns the number of bits set in either this or rhs. */
+  size_t union_count(const BitString& rhs) const {
+    return cpputil::num_set_bits(*this | rhs);
+  }
+  /** Returns the number of bits that differ between this and rhs. */
+  size_t xor_count(const BitString& rhs) const {
+    return cpputil::num_set_bits(*this ^ rhs);
+  }
+  /** Returns true if every bit set in this is also set in rhs. */
+  bool is_subset_of(const BitString& rhs) const {
+    return !any_set_bits(*this & ~rhs);
+  }
+  /** Returns true if this and rhs have any set bits in common. */
+  bool intersects(const BitString& rhs) const {
+    return any_set_bits(*this & rhs);
+  }
+
   /** Equality. */
   bool operator==(const BitString& rhs) const {
-    return contents_ == rhs.contents_ && num_bits_ == rhs.num_bits_;
+    if (num_bits_ != rhs.num_bits_) {
+      return false;
+    }
+    const auto n = num_bits_ / 64;
+    const auto p = (const uint64_t*) contents_.data();
+    const auto q = (const uint64_t*) rhs.contents_.data();
+    if (!BitKernels::equal(p, q, n)) {
+      return false;
+    }
+    return num_bits_ % 64 == 0 || ((p[n] ^ q[n]) & ((0x1ull << (num_bits_ % 64)) - 1)) == 0;
   }
   /** Inequality. */
   bool operator!=(const BitString& rhs) const {
-    return contents_ != rhs.contents_ || num_bits_ != rhs.num_bits_;
+    return !(*this == rhs);
+  }
+
+  /** Returns a hash of the bits; strings that are equal have equal hashes,
+   * whatever is in their padding. */
+  size_t hash() const {
+    const auto n = num_bits_ / 64;
+    const auto p = (const uint64_t*) contents_.data();
+    const auto h = BitKernels::hash(p, n, num_bits_);
+    return num_bits_ % 64 == 0 ? h : BitKernels::mix(h ^ (p[n] & low_mask(num_bits_ % 64)));
   }
 
   /** STL-compliant swap. */
@@ -684,6 +923,77 @@ class BitString {
  protected:
   alignas(32) T contents_;
   size_t num_bits_;
+
+  /** Unsets the bits of the last quad that are past the end of the string. */
+  void mask_tail() {
+    if (num_bits_ % 64) {
+      contents_[num_bits_ / 64] &= low_mask(num_bits_ % 64);
+    }
+  }
+
+ private:
+  /** Returns a mask of the low n bits of a quad; n may be 64. */
+  static uint64_t low_mask(size_t n) {
+    return n == 64 ? -1ull : (0x1ull << n) - 1;
+  }
+  /** Returns the n bits of p that start at bit i; n may be at most 64. */
+  static uint64_t read_bits(const uint64_t* p, size_t i, size_t n) {
+    const auto q = i / 64;
+    const auto sh = i % 64;
+    auto x = p[q] >> sh;
+    if (sh + n > 64) {
+      x |= p[q + 1] << (64 - sh);
+    }
+    return x & low_mask(n);
+  }
+  /** Writes the low n bits of x to the n bits of p that start at bit i; the
+   * bits must all belong to the same quad. */
+  static void write_bits(uint64_t* p, size_t i, size_t n, uint64_t x) {
+    assert(i % 64 + n <= 64);
+    const auto m = low_mask(n) << (i % 64);
+    p[i / 64] = (p[i / 64] & ~m) | ((x << (i % 64)) & m);
+  }
+
+  /** Applies Op to the bits in [lo, hi) and a mask of ones, or of zeros if
+   * invert is true. Only the partial quads at either end are masked. */
+  template <typename Op>
+  BitString& apply_range(size_t lo, size_t hi, bool invert) {
+    assert(lo <= hi);
+    assert(hi <= num_bits_);
+    if (lo == hi) {
+      return *this;
+    }
+
+    const auto first = lo / 64;
+    const auto last = (hi - 1) / 64;
+    const auto lo_mask = -1ull << (lo % 64);
+    const auto hi_mask = low_mask((hi - 1) % 64 + 1);
+    const uint64_t fill = invert ? 0 : -1ull;
+
+    if (first == last) {
+      const auto m = lo_mask & hi_mask;
+      contents_[first] = Op::apply(contents_[first], invert ? ~m : m);
+      return *this;
+    }
+    contents_[first] = Op::apply(contents_[first], invert ? ~lo_mask : lo_mask);
+    contents_[last] = Op::apply(contents_[last], invert ? ~hi_mask : hi_mask);
+
+    auto i = first + 1;
+#if defined(__AVX2__) && defined(__AVX__)
+    for (; i < last && i % 4; ++i) {
+      contents_[i] = Op::apply(contents_[i], fill);
+    }
+    const auto y = _mm256_set1_epi64x(fill);
+    for (; i + 4 <= last; i += 4) {
+      auto x = _mm256_load_si256((__m256i*) &contents_[i]);
+      _mm256_store_si256((__m256i*) &contents_[i], Op::apply(x, y));
+    }
+#endif
+    for (; i < last; ++i) {
+      contents_[i] = Op::apply(contents_[i], fill);
+    }
+    return *this;
+  }
 };
 
 } // namespace cpputil
@@ -696,6 +1006,14 @@ void swap(cpputil::BitString<T>& lhs, cpputil::BitString<T>& rhs) {
   lhs.swap(rhs);
 }
 
+/** STL-compliant hash. */
+template <typename T>
+struct hash<cpputil::BitString<T>> {
+  size_t operator()(const cpputil::BitString<T>& bs) const {
+    return bs.hash();
+  }
+};
+
 } // namespace
 
 #endif
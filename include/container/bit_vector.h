@@ -20,19 +20,39 @@
 #include <vector>
 
 #include "include/allocator/aligned.h"
+#include "include/allocator/alignment.h"
+#include "include/bits/bulk_copy.h"
 #include "include/container/bit_string.h"
 
 namespace cpputil {
 
-class BitVector : public BitString<std::vector<uint64_t, Aligned<uint64_t, 32>>> {
+/* A bit string that can be resized at run time. The quads are held in a
+ * std::vector with allocator A, which must allocate 32-byte aligned blocks for
+ * the aligned loads and stores in the bulk kernels; BitVector is the version
+ * that uses the heap. */
+template <typename A = Aligned<uint64_t, 32>>
+class BasicBitVector : public BitString<std::vector<uint64_t, A>> {
+  static_assert(allocator_alignment<A>::value >= 32,
+                "BasicBitVector needs an allocator with 32-byte alignment");
+
+  typedef BitString<std::vector<uint64_t, A>> base_type;
+
  public:
   /** Creates an empty bit vector. */
-  BitVector() : BitString<std::vector<uint64_t, Aligned<uint64_t, 32>>>() { }
+  BasicBitVector() : base_type() { }
   /** Creates a bit vector to hold n bits. */
-  BitVector(size_t n) : BitString<std::vector<uint64_t, Aligned<uint64_t, 32>>>() {
+  BasicBitVector(size_t n) : base_type() {
     contents_.resize((n + 63) / 64);
     num_bits_ = n;
   }
+  /** Creates a bit vector from a bit-wise expression. */
+  template <typename E>
+  BasicBitVector(const BitExpr<E>& e) :
+    BasicBitVector(BitExprOperand<E>::get(e.derived()).num_bits()) {
+    *this = e;
+  }
+
+  using base_type::operator=;
 
   /** Resizes a BitVector to contain n bits. */
   void resize_for_bits(size_t n) {
@@ -41,17 +61,17 @@ class BitVector : public BitString<std::vector<uint64_t, Aligned<uint64_t, 32>>>
   }
   /** Resizes a BitVector to contain n fixed bytes. */
   void resize_for_fixed_bytes(size_t n) {
-    contents_.resize(n + 7 / 8);
+    contents_.resize((n + 7) / 8);
     num_bits_ = 8 * n;
   }
   /** Resizes a BitVector to contain n fixed words. */
   void resize_for_fixed_words(size_t n) {
-    contents_.resize(n + 3 / 4);
+    contents_.resize((n + 3) / 4);
     num_bits_ = 16 * n;
   }
   /** Resizes a BitVector to contain n fixed doubles. */
   void resize_for_fixed_doubles(size_t n) {
-    contents_.resize(n + 1 / 2);
+    contents_.resize((n + 1) / 2);
     num_bits_ = 32 * n;
   }
   /** Resizes a BitVector to contain n fixed quads. */
@@ -61,7 +81,7 @@ class BitVector : public BitString<std::vector<uint64_t, Aligned<uint64_t, 32>>>
   }
   /** Resizes a BitVector to contain n float singles. */
   void resize_for_float_singles(size_t n) {
-    contents_.resize(n + 1 / 2);
+    contents_.resize((n + 1) / 2);
     num_bits_ = 32 * n;
   }
   /** Resizes a BitVector to contain n float doubles. */
@@ -70,17 +90,38 @@ class BitVector : public BitString<std::vector<uint64_t, Aligned<uint64_t, 32>>>
     num_bits_ = 64 * n;
   }
 
-  /** Set all elements to zero. */
-  void reset() {
-    contents_.assign(contents_.size(), 0);
+  /** Set all elements to zero. Large vectors are cleared with streaming
+   * stores unless mode says otherwise. */
+  void reset(StoreMode mode = StoreMode::AUTO) {
+    BulkCopy::fill(contents_.data(), contents_.size(), 0, mode);
   }
 
-  /** Set all elements to one. */
-  void set() {
-    contents_.assign(contents_.size(), -1);
+  /** Set all elements to one. Large vectors are filled with streaming stores
+   * unless mode says otherwise. */
+  void set(StoreMode mode = StoreMode::AUTO) {
+    BulkCopy::fill(contents_.data(), contents_.size(), -1, mode);
+    this->mask_tail();
   }
+
+ protected:
+  using base_type::contents_;
+  using base_type::num_bits_;
 };
 
+typedef BasicBitVector<> BitVector;
+
 } // namespace cpputil
 
+namespace std {
+
+/** STL-compliant hash. */
+template <typename A>
+struct hash<cpputil::BasicBitVector<A>> {
+  size_t operator()(const cpputil::BasicBitVector<A>& bs) const {
+    return bs.hash();
+  }
+};
+
+} // namespace std
+
 #endif
@@ -0,0 +1,772 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_CONTAINER_COMPRESSED_BIT_VECTOR_H
+#define CPPUTIL_INCLUDE_CONTAINER_COMPRESSED_BIT_VECTOR_H
+
+#include <cassert>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "include/bits/bit_manip.h"
+#include "include/bits/pop_count.h"
+#include "include/container/bit_vector.h"
+
+namespace cpputil {
+
+/* A compressed bit vector in the style of Roaring bitmaps. The index space is
+ * split into chunks of 2^16 bits. Empty chunks take no space at all, and every
+ * other chunk is stored in whichever container is cheapest: a sorted array of
+ * the low 16 bits of its set indices, a plain 8KB bitset, or (after a call to
+ * run_optimize()) a list of runs. See Chambi, Lemire, Kaser and Godin,
+ * "Better bitmap performance with Roaring bitmaps". */
+class CompressedBitVector {
+ private:
+  enum : size_t {
+    /** The number of bits covered by a container. */
+    CHUNK_BITS = 65536,
+    /** The number of quads in a bitset container. */
+    CHUNK_QUADS = CHUNK_BITS / 64,
+    /** Containers with more set bits than this are not stored as arrays. */
+    MAX_ARRAY = 4096
+  };
+
+  struct Container {
+    enum Kind { ARRAY, BITSET, RUN };
+
+    /** Creates an empty array container. */
+    Container() : kind(ARRAY), card(0), vals(), bits() { }
+    /** Creates an array container holding a single value. */
+    Container(uint16_t v) : kind(ARRAY), card(1), vals(1, v), bits() { }
+
+    /** STL-compliant swap. */
+    void swap(Container& rhs) {
+      std::swap(kind, rhs.kind);
+      std::swap(card, rhs.card);
+      vals.swap(rhs.vals);
+      bits.swap(rhs.bits);
+    }
+
+    Kind kind;
+    /* The number of set bits in this container; never zero */
+    size_t card;
+    /* Sorted values for arrays; (start, length - 1) pairs for runs */
+    std::vector<uint16_t> vals;
+    /* Contents for bitsets; empty otherwise */
+    BitVector bits;
+  };
+
+ public:
+  /** Iterates through the indices of the set bits in a compressed bit vector. */
+  class const_set_bit_index_iterator {
+    friend class CompressedBitVector;
+
+   public:
+    /** Return the index of the current set bit. */
+    size_t operator*() const {
+      return index_;
+    }
+    /** Increment. */
+    const_set_bit_index_iterator& operator++() {
+      const auto& c = cbv_->containers_[c_];
+      const auto low = index_ % CHUNK_BITS;
+
+      switch (c.kind) {
+      case Container::ARRAY:
+        if (++k_ < c.vals.size()) {
+          index_ += c.vals[k_] - low;
+          return *this;
+        }
+        break;
+      case Container::RUN:
+        if (low < (size_t) c.vals[k_] + c.vals[k_ + 1]) {
+          ++index_;
+          return *this;
+        } else if ((k_ += 2) < c.vals.size()) {
+          index_ += c.vals[k_] - low;
+          return *this;
+        }
+        break;
+      case Container::BITSET: {
+        const auto next = next_set(c.bits, low + 1);
+        if (next < CHUNK_BITS) {
+          index_ += next - low;
+          return *this;
+        }
+        break;
+      }
+      }
+
+      ++c_;
+      seek();
+      return *this;
+    }
+    /** Equality. */
+    bool operator==(const const_set_bit_index_iterator& rhs) const {
+      return index_ == rhs.index_;
+    }
+    /** Inequality. */
+    bool operator!=(const const_set_bit_index_iterator& rhs) const {
+      return index_ != rhs.index_;
+    }
+
+   private:
+    /** Constructor. */
+    const_set_bit_index_iterator(const CompressedBitVector* cbv, size_t c) : cbv_(cbv), c_(c) {
+      seek();
+    }
+
+    /** Moves to the first set bit in the current container. */
+    void seek() {
+      if (c_ == cbv_->containers_.size()) {
+        index_ = cbv_->num_bits_;
+        return;
+      }
+
+      const auto& c = cbv_->containers_[c_];
+      k_ = 0;
+      index_ = cbv_->keys_[c_] * CHUNK_BITS;
+      index_ += c.kind == Container::BITSET ? next_set(c.bits, 0) : c.vals[0];
+    }
+
+    const CompressedBitVector* cbv_;
+    /* The index of the current container */
+    size_t c_;
+    /* The current position in the container's vals, if it has any */
+    size_t k_;
+    /* The index of the current set bit */
+    size_t index_;
+  };
+
+  class bit_type {
+    friend class CompressedBitVector;
+
+   public:
+    /** Assignment operator. */
+    bit_type& operator=(bool rhs) {
+      if (rhs) {
+        cbv_.set_bit(i_);
+      } else {
+        cbv_.reset_bit(i_);
+      }
+      return *this;
+    }
+    /** Implicit conversion to bool. */
+    operator bool() const {
+      return const_cast<const CompressedBitVector&>(cbv_).get_bit(i_);
+    }
+
+   private:
+    /** Constructor. */
+    bit_type(CompressedBitVector& cbv, size_t i) : cbv_(cbv), i_(i) { }
+
+    CompressedBitVector& cbv_;
+    size_t i_;
+  };
+
+  /** Creates an empty compressed bit vector. */
+  CompressedBitVector() : num_bits_(0) { }
+  /** Creates a compressed bit vector to hold n bits, all of which are unset. */
+  CompressedBitVector(size_t n) : num_bits_(n) { }
+  /** Creates a compressed bit vector with the same contents as a bit vector. */
+  explicit CompressedBitVector(const BitVector& bv) : num_bits_(bv.num_bits()) {
+    const auto p = (const uint64_t*) bv.data();
+    const auto nq = (num_bits_ + 63) / 64;
+    const uint64_t tail = num_bits_ % 64 ? (0x1ull << (num_bits_ % 64)) - 1 : ~0ull;
+
+    for (size_t begin = 0; begin < nq; begin += CHUNK_QUADS) {
+      const auto n = std::min((size_t) CHUNK_QUADS, nq - begin);
+      const uint64_t last = p[begin + n - 1] & (begin + n == nq ? tail : ~0ull);
+      const auto card = PopCount::count(p + begin, n - 1) + BitManip<uint64_t>::pop_count(last);
+      if (card == 0) {
+        continue;
+      }
+
+      keys_.push_back(begin / CHUNK_QUADS);
+      containers_.push_back(Container());
+      auto& c = containers_.back();
+      c.card = card;
+
+      if (card <= MAX_ARRAY) {
+        c.vals.clear();
+        c.vals.reserve(card);
+        for (size_t i = 0; i < n; ++i) {
+          for (uint64_t w = i + 1 == n ? last : p[begin + i]; w; BitManip<uint64_t>::unset_rightmost(w)) {
+            c.vals.push_back(64 * i + BitManip<uint64_t>::ntz(w));
+          }
+        }
+      } else {
+        c.kind = Container::BITSET;
+        c.vals = std::vector<uint16_t>();
+        c.bits.resize_for_bits(CHUNK_BITS);
+        std::copy(p + begin, p + begin + n, c.bits.fixed_quad_begin());
+        c.bits.get_fixed_quad(n - 1) = last;
+      }
+    }
+  }
+
+  /** Returns a bit vector with the same contents as this. */
+  BitVector to_bit_vector() const {
+    BitVector res(num_bits_);
+    auto p = res.fixed_quad_begin();
+    const auto nq = (num_bits_ + 63) / 64;
+
+    for (size_t i = 0, ie = keys_.size(); i < ie; ++i) {
+      const auto& c = containers_[i];
+      const auto base = keys_[i] * CHUNK_QUADS;
+
+      switch (c.kind) {
+      case Container::ARRAY:
+        for (auto v : c.vals) {
+          p[base + v / 64] |= 0x1ull << (v % 64);
+        }
+        break;
+      case Container::BITSET:
+        std::copy(c.bits.fixed_quad_begin(),
+                  c.bits.fixed_quad_begin() + std::min((size_t) CHUNK_QUADS, nq - base), p + base);
+        break;
+      case Container::RUN:
+        for (size_t k = 0; k < c.vals.size(); k += 2) {
+          for (size_t v = c.vals[k], ve = v + c.vals[k + 1]; v <= ve; ++v) {
+            p[base + v / 64] |= 0x1ull << (v % 64);
+          }
+        }
+        break;
+      }
+    }
+
+    return res;
+  }
+
+  /** Returns the number of bits in this vector. */
+  size_t num_bits() const {
+    return num_bits_;
+  }
+  /** Returns the number of set bits in this vector. */
+  size_t num_set_bits() const {
+    size_t res = 0;
+    for (const auto& c : containers_) {
+      res += c.card;
+    }
+    return res;
+  }
+  /** Returns the number of bytes used by this vector, including its heap storage. */
+  size_t num_bytes() const {
+    auto res = sizeof(*this) + keys_.capacity() * sizeof(size_t) +
+               containers_.capacity() * sizeof(Container);
+    for (const auto& c : containers_) {
+      res += c.vals.capacity() * sizeof(uint16_t) + c.bits.num_fixed_quads() * sizeof(uint64_t);
+    }
+    return res;
+  }
+
+  /** Returns a bit. */
+  bit_type get_bit(size_t i) {
+    assert(i < num_bits());
+    return bit_type(*this, i);
+  }
+  /** Returns a const bool value. */
+  bool get_bit(size_t i) const {
+    const auto itr = std::lower_bound(keys_.begin(), keys_.end(), i / CHUNK_BITS);
+    return itr != keys_.end() && *itr == i / CHUNK_BITS &&
+           contains(containers_[itr - keys_.begin()], i % CHUNK_BITS);
+  }
+  /** Sets a bit. */
+  void set_bit(size_t i) {
+    assert(i < num_bits());
+    const auto itr = std::lower_bound(keys_.begin(), keys_.end(), i / CHUNK_BITS);
+    const auto c = itr - keys_.begin();
+    if (itr == keys_.end() || *itr != i / CHUNK_BITS) {
+      keys_.insert(itr, i / CHUNK_BITS);
+      containers_.insert(containers_.begin() + c, Container(i % CHUNK_BITS));
+    } else {
+      add(containers_[c], i % CHUNK_BITS);
+    }
+  }
+  /** Unsets a bit. */
+  void reset_bit(size_t i) {
+    assert(i < num_bits());
+    const auto itr = std::lower_bound(keys_.begin(), keys_.end(), i / CHUNK_BITS);
+    const auto c = itr - keys_.begin();
+    if (itr != keys_.end() && *itr == i / CHUNK_BITS) {
+      remove(containers_[c], i % CHUNK_BITS);
+      if (containers_[c].card == 0) {
+        keys_.erase(itr);
+        containers_.erase(containers_.begin() + c);
+      }
+    }
+  }
+
+  /** Subscript operator. */
+  bit_type operator[](size_t i) {
+    return get_bit(i);
+  }
+  /** Subscript operator. */
+  bool operator[](size_t i) const {
+    return get_bit(i);
+  }
+
+  /** Set bit index iterator. */
+  const_set_bit_index_iterator set_bit_index_begin() const {
+    return const_set_bit_index_iterator(this, 0);
+  }
+  /** Set bit index iterator. */
+  const_set_bit_index_iterator set_bit_index_end() const {
+    return const_set_bit_index_iterator(this, containers_.size());
+  }
+
+  /** Unsets every bit. */
+  void reset() {
+    keys_.clear();
+    containers_.clear();
+  }
+
+  /** Converts containers to run lists wherever that saves space. This is
+   * worth calling once a vector is done being modified. */
+  void run_optimize() {
+    for (auto& c : containers_) {
+      if (c.kind == Container::RUN) {
+        continue;
+      }
+      const auto runs = num_runs(c);
+      const auto size = c.kind == Container::ARRAY ? 2 * c.card : 8 * (size_t) CHUNK_QUADS;
+      if (4 * runs < size) {
+        to_run(c, runs);
+      }
+    }
+  }
+
+  /** Bit-wise and. */
+  CompressedBitVector& operator&=(const CompressedBitVector& rhs) {
+    assert(num_bits_ == rhs.num_bits_);
+
+    size_t i = 0, j = 0, out = 0;
+    while (i < keys_.size() && j < rhs.keys_.size()) {
+      if (keys_[i] < rhs.keys_[j]) {
+        ++i;
+      } else if (keys_[i] > rhs.keys_[j]) {
+        ++j;
+      } else {
+        and_assign(containers_[i], rhs.containers_[j]);
+        if (containers_[i].card > 0) {
+          keys_[out] = keys_[i];
+          containers_[out].swap(containers_[i]);
+          ++out;
+        }
+        ++i;
+        ++j;
+      }
+    }
+
+    keys_.resize(out);
+    containers_.erase(containers_.begin() + out, containers_.end());
+    return *this;
+  }
+  /** Bit-wise or. */
+  CompressedBitVector& operator|=(const CompressedBitVector& rhs) {
+    return merge(rhs, or_assign);
+  }
+  /** Bit-wise xor. */
+  CompressedBitVector& operator^=(const CompressedBitVector& rhs) {
+    return merge(rhs, xor_assign);
+  }
+
+  /** STL-compliant swap. */
+  void swap(CompressedBitVector& rhs) {
+    keys_.swap(rhs.keys_);
+    containers_.swap(rhs.containers_);
+    std::swap(num_bits_, rhs.num_bits_);
+  }
+
+ private:
+  /* Container keys in ascending order; keys_[i] is the chunk held by containers_[i] */
+  std::vector<size_t> keys_;
+  std::vector<Container> containers_;
+  size_t num_bits_;
+
+  /** Returns the index of the first set bit in a bitset container at or after i. */
+  static size_t next_set(const BitVector& bits, size_t i) {
+    if (i >= CHUNK_BITS) {
+      return CHUNK_BITS;
+    }
+    const auto p = bits.fixed_quad_begin();
+    auto q = i / 64;
+    auto w = p[q] & (~0ull << (i % 64));
+    while (w == 0) {
+      if (++q == CHUNK_QUADS) {
+        return CHUNK_BITS;
+      }
+      w = p[q];
+    }
+    return 64 * q + BitManip<uint64_t>::ntz(w);
+  }
+
+  /** Returns true if a container holds a value. */
+  static bool contains(const Container& c, uint16_t v) {
+    switch (c.kind) {
+    case Container::ARRAY:
+      return std::binary_search(c.vals.begin(), c.vals.end(), v);
+    case Container::BITSET:
+      return c.bits.get_bit(v);
+    case Container::RUN: {
+      // Find the last run that starts at or before v
+      size_t lo = 0, hi = c.vals.size() / 2;
+      while (lo < hi) {
+        const auto mid = (lo + hi) / 2;
+        if (c.vals[2 * mid] <= v) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      return lo > 0 && v <= (size_t) c.vals[2 * lo - 2] + c.vals[2 * lo - 1];
+    }
+    }
+    return false;
+  }
+
+  /** Adds a value to a container. */
+  static void add(Container& c, uint16_t v) {
+    expand(c);
+    if (c.kind == Container::ARRAY) {
+      const auto itr = std::lower_bound(c.vals.begin(), c.vals.end(), v);
+      if (itr == c.vals.end() || *itr != v) {
+        c.vals.insert(itr, v);
+        if (++c.card > MAX_ARRAY) {
+          to_bitset(c);
+        }
+      }
+    } else if (!c.bits.get_bit(v)) {
+      c.bits.get_bit(v) = true;
+      ++c.card;
+    }
+  }
+
+  /** Removes a value from a container. */
+  static void remove(Container& c, uint16_t v) {
+    expand(c);
+    if (c.kind == Container::ARRAY) {
+      const auto itr = std::lower_bound(c.vals.begin(), c.vals.end(), v);
+      if (itr != c.vals.end() && *itr == v) {
+        c.vals.erase(itr);
+        --c.card;
+      }
+    } else if (c.bits.get_bit(v)) {
+      c.bits.get_bit(v) = false;
+      --c.card;
+      shrink(c);
+    }
+  }
+
+  /** Converts an array or run container to a bitset. */
+  static void to_bitset(Container& c) {
+    BitVector bits(CHUNK_BITS);
+    auto p = bits.fixed_quad_begin();
+    if (c.kind == Container::ARRAY) {
+      for (auto v : c.vals) {
+        p[v / 64] |= 0x1ull << (v % 64);
+      }
+    } else {
+      for (size_t k = 0; k < c.vals.size(); k += 2) {
+        for (size_t v = c.vals[k], ve = v + c.vals[k + 1]; v <= ve; ++v) {
+          p[v / 64] |= 0x1ull << (v % 64);
+        }
+      }
+    }
+    c.kind = Container::BITSET;
+    c.vals = std::vector<uint16_t>();
+    c.bits.swap(bits);
+  }
+
+  /** Converts a bitset or run container to an array. */
+  static void to_array(Container& c) {
+    std::vector<uint16_t> vals;
+    vals.reserve(c.card);
+    if (c.kind == Container::BITSET) {
+      const auto p = c.bits.fixed_quad_begin();
+      for (size_t i = 0; i < CHUNK_QUADS; ++i) {
+        for (uint64_t w = p[i]; w; BitManip<uint64_t>::unset_rightmost(w)) {
+          vals.push_back(64 * i + BitManip<uint64_t>::ntz(w));
+        }
+      }
+    } else {
+      for (size_t k = 0; k < c.vals.size(); k += 2) {
+        for (size_t v = c.vals[k], ve = v + c.vals[k + 1]; v <= ve; ++v) {
+          vals.push_back(v);
+        }
+      }
+    }
+    c.kind = Container::ARRAY;
+    c.vals.swap(vals);
+    BitVector().swap(c.bits);
+  }
+
+  /** Converts an array or bitset container with the given number of runs to a run list. */
+  static void to_run(Container& c, size_t runs) {
+    std::vector<uint16_t> vals;
+    vals.reserve(2 * runs);
+    if (c.kind == Container::ARRAY) {
+      for (size_t k = 0; k < c.vals.size(); ++k) {
+        if (k == 0 || c.vals[k] != c.vals[k - 1] + 1) {
+          vals.push_back(c.vals[k]);
+          vals.push_back(0);
+        } else {
+          ++vals.back();
+        }
+      }
+    } else {
+      for (auto v = next_set(c.bits, 0); v < CHUNK_BITS; ) {
+        size_t end = v;
+        while (end + 1 < CHUNK_BITS && c.bits.get_bit(end + 1)) {
+          ++end;
+        }
+        vals.push_back(v);
+        vals.push_back(end - v);
+        v = next_set(c.bits, end + 1);
+      }
+    }
+    c.kind = Container::RUN;
+    c.vals.swap(vals);
+    BitVector().swap(c.bits);
+  }
+
+  /** Returns the number of runs of set bits in an array or bitset container. */
+  static size_t num_runs(const Container& c) {
+    size_t res = 0;
+    if (c.kind == Container::ARRAY) {
+      for (size_t k = 0; k < c.vals.size(); ++k) {
+        res += (k == 0 || c.vals[k] != c.vals[k - 1] + 1) ? 1 : 0;
+      }
+    } else {
+      // A run starts wherever a set bit follows an unset bit
+      uint64_t carry = 0;
+      for (auto i = c.bits.fixed_quad_begin(), ie = c.bits.fixed_quad_end(); i != ie; ++i) {
+        res += BitManip<uint64_t>::pop_count(*i & ~((*i << 1) | carry));
+        carry = *i >> 63;
+      }
+    }
+    return res;
+  }
+
+  /** Converts a run container to whichever of the other two kinds fits its cardinality. */
+  static void expand(Container& c) {
+    if (c.kind == Container::RUN) {
+      if (c.card <= MAX_ARRAY) {
+        to_array(c);
+      } else {
+        to_bitset(c);
+      }
+    }
+  }
+
+  /** Converts a sparse bitset container to an array. */
+  static void shrink(Container& c) {
+    if (c.kind == Container::BITSET && c.card <= MAX_ARRAY) {
+      to_array(c);
+    }
+  }
+
+  /** Returns an expanded copy of a container if it holds runs, and the container itself otherwise. */
+  static const Container& expanded(const Container& c, Container& tmp) {
+    if (c.kind != Container::RUN) {
+      return c;
+    }
+    tmp = c;
+    expand(tmp);
+    return tmp;
+  }
+
+  /** Container and. The result may be empty. */
+  static void and_assign(Container& c, const Container& rhs) {
+    Container tmp;
+    const auto& d = expanded(rhs, tmp);
+    expand(c);
+
+    if (c.kind == Container::ARRAY && d.kind == Container::ARRAY) {
+      // A branch-free merge; the comparisons are unpredictable for random data
+      size_t i = 0, j = 0, k = 0;
+      while (i < c.vals.size() && j < d.vals.size()) {
+        const auto x = c.vals[i];
+        const auto y = d.vals[j];
+        c.vals[k] = x;
+        k += x == y;
+        i += x <= y;
+        j += y <= x;
+      }
+      c.vals.resize(k);
+      c.card = k;
+    } else if (c.kind == Container::ARRAY) {
+      const auto end = std::remove_if(c.vals.begin(), c.vals.end(), [&d](uint16_t v) {
+        return !d.bits.get_bit(v);
+      });
+      c.vals.erase(end, c.vals.end());
+      c.card = c.vals.size();
+    } else if (d.kind == Container::ARRAY) {
+      std::vector<uint16_t> vals;
+      for (auto v : d.vals) {
+        if (c.bits.get_bit(v)) {
+          vals.push_back(v);
+        }
+      }
+      c.kind = Container::ARRAY;
+      c.card = vals.size();
+      c.vals.swap(vals);
+      BitVector().swap(c.bits);
+    } else {
+      // Count first so that sparse results never have to be written as bitsets
+      c.card = c.bits.intersect_count(d.bits);
+      if (c.card > MAX_ARRAY) {
+        c.bits &= d.bits;
+      } else {
+        std::vector<uint16_t> vals;
+        vals.reserve(c.card);
+        const auto p = c.bits.fixed_quad_begin();
+        const auto q = d.bits.fixed_quad_begin();
+        for (size_t i = 0; i < CHUNK_QUADS; ++i) {
+          for (uint64_t w = p[i] & q[i]; w; BitManip<uint64_t>::unset_rightmost(w)) {
+            vals.push_back(64 * i + BitManip<uint64_t>::ntz(w));
+          }
+        }
+        c.kind = Container::ARRAY;
+        c.vals.swap(vals);
+        BitVector().swap(c.bits);
+      }
+    }
+  }
+
+  /** Container or. */
+  static void or_assign(Container& c, const Container& rhs) {
+    Container tmp;
+    const auto& d = expanded(rhs, tmp);
+    expand(c);
+
+    if (c.kind == Container::ARRAY && d.kind == Container::ARRAY) {
+      std::vector<uint16_t> vals;
+      vals.reserve(c.vals.size() + d.vals.size());
+      std::set_union(c.vals.begin(), c.vals.end(), d.vals.begin(), d.vals.end(),
+                     std::back_inserter(vals));
+      c.card = vals.size();
+      c.vals.swap(vals);
+      if (c.card > MAX_ARRAY) {
+        to_bitset(c);
+      }
+      return;
+    }
+
+    if (c.kind == Container::ARRAY) {
+      std::vector<uint16_t> vals;
+      vals.swap(c.vals);
+      c.kind = Container::BITSET;
+      c.bits = d.bits;
+      for (auto v : vals) {
+        c.bits.get_bit(v) = true;
+      }
+    } else if (d.kind == Container::ARRAY) {
+      for (auto v : d.vals) {
+        c.bits.get_bit(v) = true;
+      }
+    } else {
+      c.bits |= d.bits;
+    }
+    c.card = c.bits.num_set_bits();
+  }
+
+  /** Container xor. The result may be empty. */
+  static void xor_assign(Container& c, const Container& rhs) {
+    Container tmp;
+    const auto& d = expanded(rhs, tmp);
+    expand(c);
+
+    if (c.kind == Container::ARRAY && d.kind == Container::ARRAY) {
+      std::vector<uint16_t> vals;
+      vals.reserve(c.vals.size() + d.vals.size());
+      std::set_symmetric_difference(c.vals.begin(), c.vals.end(), d.vals.begin(), d.vals.end(),
+                                    std::back_inserter(vals));
+      c.card = vals.size();
+      c.vals.swap(vals);
+      if (c.card > MAX_ARRAY) {
+        to_bitset(c);
+      }
+      return;
+    }
+
+    if (c.kind == Container::ARRAY) {
+      std::vector<uint16_t> vals;
+      vals.swap(c.vals);
+      c.kind = Container::BITSET;
+      c.bits = d.bits;
+      for (auto v : vals) {
+        c.bits.get_bit(v) = !c.bits.get_bit(v);
+      }
+    } else if (d.kind == Container::ARRAY) {
+      for (auto v : d.vals) {
+        c.bits.get_bit(v) = !c.bits.get_bit(v);
+      }
+    } else {
+      c.bits ^= d.bits;
+    }
+    c.card = c.bits.num_set_bits();
+    if (c.card > 0) {
+      shrink(c);
+    }
+  }
+
+  /** Merges the containers of rhs into this one, dropping any that end up empty. */
+  CompressedBitVector& merge(const CompressedBitVector& rhs, void (*op)(Container&, const Container&)) {
+    assert(num_bits_ == rhs.num_bits_);
+
+    std::vector<size_t> keys;
+    std::vector<Container> containers;
+    keys.reserve(keys_.size() + rhs.keys_.size());
+    containers.reserve(keys_.size() + rhs.keys_.size());
+
+    size_t i = 0, j = 0;
+    while (i < keys_.size() || j < rhs.keys_.size()) {
+      if (j == rhs.keys_.size() || (i < keys_.size() && keys_[i] < rhs.keys_[j])) {
+        keys.push_back(keys_[i]);
+        containers.push_back(std::move(containers_[i++]));
+      } else if (i == keys_.size() || keys_[i] > rhs.keys_[j]) {
+        keys.push_back(rhs.keys_[j]);
+        containers.push_back(rhs.containers_[j++]);
+      } else {
+        op(containers_[i], rhs.containers_[j++]);
+        if (containers_[i].card > 0) {
+          keys.push_back(keys_[i]);
+          containers.push_back(std::move(containers_[i]));
+        }
+        ++i;
+      }
+    }
+
+    keys_.swap(keys);
+    containers_.swap(containers);
+    return *this;
+  }
+};
+
+} // namespace cpputil
+
+namespace std {
+
+/** STL-compliant swap. */
+inline void swap(cpputil::CompressedBitVector& lhs, cpputil::CompressedBitVector& rhs) {
+  lhs.swap(rhs);
+}
+
+} // namespace std
+
+#endif
@@ -0,0 +1,301 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_CONTAINER_MAPPED_BIT_VECTOR_H
+#define CPPUTIL_INCLUDE_CONTAINER_MAPPED_BIT_VECTOR_H
+
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "include/container/bit_string.h"
+
+namespace cpputil {
+
+/* The quads of a memory-mapped bit vector. Provides just enough of the
+ * std::vector interface for BitString. Owns its mapping, so it can be moved
+ * but not copied. */
+class MappedQuads {
+  friend class MappedBitVector;
+
+ public:
+  typedef uint64_t value_type;
+  typedef uint64_t* iterator;
+  typedef const uint64_t* const_iterator;
+
+  /** Creates an empty set of quads. */
+  MappedQuads() : base_(nullptr), len_(0), data_(nullptr), size_(0) { }
+  MappedQuads(const MappedQuads& rhs) = delete;
+  MappedQuads& operator=(const MappedQuads& rhs) = delete;
+  /** Move constructor. */
+  MappedQuads(MappedQuads&& rhs) : MappedQuads() {
+    swap(rhs);
+  }
+  /** Move assignment operator. */
+  MappedQuads& operator=(MappedQuads&& rhs) {
+    MappedQuads(std::move(rhs)).swap(*this);
+    return *this;
+  }
+  /** Unmaps the quads. */
+  ~MappedQuads() {
+    if (base_ != nullptr) {
+      munmap(base_, len_);
+    }
+  }
+
+  /** Returns the number of quads. */
+  size_t size() const {
+    return size_;
+  }
+  /** Returns the quads. */
+  uint64_t* data() {
+    return data_;
+  }
+  /** Returns the quads. */
+  const uint64_t* data() const {
+    return data_;
+  }
+
+  /** Returns a quad. */
+  uint64_t& operator[](size_t i) {
+    return data_[i];
+  }
+  /** Returns a quad. */
+  const uint64_t& operator[](size_t i) const {
+    return data_[i];
+  }
+
+  /** Quad iterator. */
+  iterator begin() {
+    return data_;
+  }
+  /** Quad iterator. */
+  iterator end() {
+    return data_ + size_;
+  }
+  /** Quad iterator. */
+  const_iterator begin() const {
+    return data_;
+  }
+  /** Quad iterator. */
+  const_iterator end() const {
+    return data_ + size_;
+  }
+
+  /** STL-compliant swap. */
+  void swap(MappedQuads& rhs) {
+    std::swap(base_, rhs.base_);
+    std::swap(len_, rhs.len_);
+    std::swap(data_, rhs.data_);
+    std::swap(size_, rhs.size_);
+  }
+
+ private:
+  /** The whole mapping, header included. */
+  void* base_;
+  size_t len_;
+  /** The quads, which start part way into the mapping. */
+  uint64_t* data_;
+  size_t size_;
+};
+
+/* A bit vector that lives in a file. Opening one maps the file rather than
+ * reading it, so opening takes the same time however large the file is, and
+ * pages are read in by the kernel as they are touched. Everything else works
+ * on the mapping directly, the same way it works on a BitVector. The mapping
+ * is private and copy-on-write, so writes are never seen by the file or
+ * anyone else; ConstMappedBitVector maps a file that is shared instead.
+ *
+ * Files are written by save(). They start with a 64-byte header that holds a
+ * magic number, a format version and the number of bits. The quads follow the
+ * header, so they are 64-byte aligned in the mapping. */
+class MappedBitVector : public BitString<MappedQuads> {
+  friend class ConstMappedBitVector;
+
+ public:
+  enum : uint32_t {
+    /** The format version written by save() and accepted by open(). */
+    VERSION = 1
+  };
+
+  /** Creates an empty bit vector that isn't backed by a file. */
+  MappedBitVector() : BitString<MappedQuads>() { }
+  /** Maps a file; check is_open() to see whether it worked. */
+  explicit MappedBitVector(const std::string& path) : BitString<MappedQuads>() {
+    open(path);
+  }
+
+  using BitString<MappedQuads>::operator=;
+
+  /** Maps a file written by save(), replacing the current contents. Returns
+   * false, leaving this bit vector empty, if the file can't be mapped or
+   * doesn't hold a bit vector of the current version that fits in the file
+   * and has no bits set past its end. */
+  bool open(const std::string& path) {
+    return map(path, false);
+  }
+
+  /** Returns true if this bit vector is backed by a file. */
+  bool is_open() const {
+    return contents_.base_ != nullptr;
+  }
+
+  /** Unmaps the file, if any, leaving this bit vector empty. */
+  void close() {
+    MappedQuads().swap(contents_);
+    num_bits_ = 0;
+  }
+
+  /** Writes a bit string to a file that can be mapped by open(). The bits
+   * past the end of the string are written as zeros. */
+  template <typename T>
+  static bool save(const BitString<T>& bs, const std::string& path) {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+
+    Header h;
+    memcpy(h.magic, magic(), sizeof(h.magic));
+    h.version = VERSION;
+    h.header_bytes = sizeof(Header);
+    h.num_bits = bs.num_bits();
+    ofs.write((const char*) &h, sizeof(h));
+
+    const auto p = (const uint64_t*) bs.data();
+    const auto n = bs.num_bits() / 64;
+    ofs.write((const char*) p, 8 * n);
+    if (bs.num_bits() % 64) {
+      const uint64_t last = p[n] & ((0x1ull << (bs.num_bits() % 64)) - 1);
+      ofs.write((const char*) &last, sizeof(last));
+    }
+
+    ofs.close();
+    return !ofs.fail();
+  }
+
+ private:
+  struct Header {
+    Header() {
+      memset(this, 0, sizeof(*this));
+    }
+
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes;
+    uint64_t num_bits;
+    uint8_t reserved[40];
+  };
+  static_assert(sizeof(Header) == 64, "Header must preserve the alignment of the quads");
+
+  /** Returns the bytes that every file begins with. */
+  static const char* magic() {
+    return "CPPUTILB";
+  }
+
+  /** Does the work of open(). A shared mapping can only be read; a private
+   * one can be written. */
+  bool map(const std::string& path, bool shared) {
+    close();
+
+    const auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header)) {
+      ::close(fd);
+      return false;
+    }
+
+    const auto len = (size_t) st.st_size;
+    const auto prot = shared ? PROT_READ : (PROT_READ | PROT_WRITE);
+    const auto flags = shared ? MAP_SHARED : MAP_PRIVATE;
+    const auto base = mmap(nullptr, len, prot, flags, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      return false;
+    }
+
+    // The bit count is checked against the file before it's rounded up to
+    // quads, which would overflow for counts near 2^64. Files whose last quad
+    // has bits set past the end are rejected too, since save() never writes
+    // them and every whole-quad operation assumes they are clear.
+    Header h;
+    memcpy(&h, base, sizeof(h));
+    if (memcmp(h.magic, magic(), sizeof(h.magic)) != 0 || h.version != VERSION ||
+        h.header_bytes != sizeof(Header) || h.num_bits > (len - sizeof(Header)) / 8 * 64) {
+      munmap(base, len);
+      return false;
+    }
+    const auto quads = (h.num_bits + 63) / 64;
+    const auto data = (const uint64_t*)((const char*) base + sizeof(Header));
+    if (h.num_bits % 64 && (data[quads - 1] >> (h.num_bits % 64)) != 0) {
+      munmap(base, len);
+      return false;
+    }
+
+    contents_.base_ = base;
+    contents_.len_ = len;
+    contents_.data_ = (uint64_t*)((char*) base + sizeof(Header));
+    contents_.size_ = quads;
+    num_bits_ = h.num_bits;
+    return true;
+  }
+};
+
+/* A bit vector file that is mapped read-only and shared with every other
+ * process that maps it, so they all use one copy of the pages. The pages
+ * can't be written, so only a const BitString is exposed; a write fails to
+ * compile rather than faulting. */
+class ConstMappedBitVector {
+ public:
+  /** Creates an empty bit vector that isn't backed by a file. */
+  ConstMappedBitVector() { }
+  /** Maps a file; check is_open() to see whether it worked. */
+  explicit ConstMappedBitVector(const std::string& path) {
+    open(path);
+  }
+
+  /** Maps a file written by MappedBitVector::save(), replacing the current
+   * contents. Fails in the same cases as MappedBitVector::open(). */
+  bool open(const std::string& path) {
+    return bv_.map(path, true);
+  }
+  /** Returns true if this bit vector is backed by a file. */
+  bool is_open() const {
+    return bv_.is_open();
+  }
+  /** Unmaps the file, if any, leaving this bit vector empty. */
+  void close() {
+    bv_.close();
+  }
+
+  /** Returns the bits. */
+  const BitString<MappedQuads>& bits() const {
+    return bv_;
+  }
+
+ private:
+  MappedBitVector bv_;
+};
+
+} // namespace cpputil
+
+#endif
@@ -0,0 +1,208 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_CONTAINER_RANK_SELECT_H
+#define CPPUTIL_INCLUDE_CONTAINER_RANK_SELECT_H
+
+#include <cassert>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "include/bits/bit_manip.h"
+#include "include/container/bit_string.h"
+#include "include/system/cpu_features.h"
+
+namespace cpputil {
+
+/* A succinct rank/select index over a bit string. The index stores the
+ * number of set bits that precede every 4096-bit superblock (64 bits each)
+ * and every 512-bit block within a superblock (16 bits each), plus the
+ * superblock that holds every 8192'nd set bit. That comes to a little over 5%
+ * of the size of the bit string. rank() reads at most eight quads; select()
+ * narrows the search to a handful of superblocks using the samples, and then
+ * does the same amount of work as rank().
+ *
+ * The index refers to the bit string it was built from rather than copying
+ * it, so the bit string must outlive the index and must not be modified. */
+class RankSelect {
+ private:
+  enum : size_t {
+    /** Quads in a block. */
+    BLOCK_QUADS = 8,
+    /** Blocks in a superblock. */
+    SUPER_BLOCKS = 8,
+    /** Quads in a superblock. */
+    SUPER_QUADS = BLOCK_QUADS * SUPER_BLOCKS,
+    /** Set bits between select samples. */
+    SAMPLE_RATE = 8192
+  };
+
+ public:
+  /** Builds an index over a bit string. */
+  template <typename T>
+  explicit RankSelect(const BitString<T>& bs) :
+    data_((const uint64_t*) bs.data()), num_bits_(bs.num_bits()), num_set_bits_(0) {
+    const auto nq = (num_bits_ + 63) / 64;
+    supers_.reserve(nq / SUPER_QUADS + 1);
+    blocks_.reserve(nq / BLOCK_QUADS + 1);
+
+    size_t in_super = 0;
+    size_t next_sample = 0;
+    for (size_t i = 0; i < nq; ++i) {
+      if (i % SUPER_QUADS == 0) {
+        supers_.push_back(num_set_bits_);
+        in_super = 0;
+      }
+      if (i % BLOCK_QUADS == 0) {
+        blocks_.push_back(in_super);
+      }
+
+      const auto pc = BitManip<uint64_t>::pop_count(quad(i));
+      for (; next_sample < num_set_bits_ + pc; next_sample += SAMPLE_RATE) {
+        samples_.push_back(i / SUPER_QUADS);
+      }
+      num_set_bits_ += pc;
+      in_super += pc;
+    }
+
+    // Sentinels so that rank(num_bits()) and the last sample range are well defined
+    if (nq % SUPER_QUADS == 0) {
+      supers_.push_back(num_set_bits_);
+      in_super = 0;
+    }
+    if (nq % BLOCK_QUADS == 0) {
+      blocks_.push_back(in_super);
+    }
+    samples_.push_back(supers_.size() - 1);
+  }
+
+  /** Returns the number of bits in the indexed bit string. */
+  size_t num_bits() const {
+    return num_bits_;
+  }
+  /** Returns the number of set bits in the indexed bit string. */
+  size_t num_set_bits() const {
+    return num_set_bits_;
+  }
+  /** Returns the number of bytes used by the index. */
+  size_t num_bytes() const {
+    return sizeof(*this) + supers_.capacity() * sizeof(uint64_t) +
+           blocks_.capacity() * sizeof(uint16_t) + samples_.capacity() * sizeof(uint32_t);
+  }
+
+  /** Returns the number of set bits in [0, i). Without popcnt at compile
+   * time, the host is asked once which version to use, so that the quads
+   * aren't counted through one indirect call each. */
+  size_t rank(size_t i) const {
+#ifdef __POPCNT__
+    return rank<true>(i);
+#else
+    return rank_kernel()(*this, i);
+#endif
+  }
+
+  /** Returns the index of the k'th (counting from zero) set bit; k must be
+   * less than num_set_bits(). */
+  size_t select(size_t k) const {
+    assert(k < num_set_bits_);
+
+    // The superblock is bracketed by the samples on either side of k
+    const auto lo = supers_.begin() + samples_[k / SAMPLE_RATE];
+    const auto hi = supers_.begin() + samples_[k / SAMPLE_RATE + 1] + 1;
+    const auto s = (std::upper_bound(lo, hi, k) - supers_.begin()) - 1;
+    k -= supers_[s];
+
+    auto b = s * SUPER_BLOCKS;
+    const auto be = std::min(b + SUPER_BLOCKS, blocks_.size());
+    while (b + 1 < be && blocks_[b + 1] <= k) {
+      ++b;
+    }
+    k -= blocks_[b];
+
+    for (auto q = b * BLOCK_QUADS; ; ++q) {
+      const auto pc = BitManip<uint64_t>::pop_count(data_[q]);
+      if (k < pc) {
+        return 64 * q + BitManip<uint64_t>::select(data_[q], k);
+      }
+      k -= pc;
+    }
+  }
+
+ private:
+  const uint64_t* data_;
+  size_t num_bits_;
+  size_t num_set_bits_;
+
+  /* Set bits before each superblock */
+  std::vector<uint64_t> supers_;
+  /* Set bits before each block, relative to the start of its superblock */
+  std::vector<uint16_t> blocks_;
+  /* The superblock that holds every SAMPLE_RATE'th set bit */
+  std::vector<uint32_t> samples_;
+
+  typedef size_t (*rank_type)(const RankSelect&, size_t);
+
+  /** Returns the rank() used on this host. */
+  static rank_type rank_kernel() {
+    static const rank_type k = CpuFeatures::has_popcnt() ? rank_popcnt : rank_scalar;
+    return k;
+  }
+  /** rank() with the popcnt instruction. */
+  __attribute__((target("popcnt")))
+  static size_t rank_popcnt(const RankSelect& rs, size_t i) {
+    return rs.rank<true>(i);
+  }
+  /** rank() with the portable pop_count(). */
+  static size_t rank_scalar(const RankSelect& rs, size_t i) {
+    return rs.rank<false>(i);
+  }
+  /** rank(), counting with popcnt if Popcnt is true. Callers that pass true
+   * must be compiled for popcnt. */
+  template <bool Popcnt>
+  __attribute__((always_inline))
+  inline size_t rank(size_t i) const {
+    assert(i <= num_bits_);
+    const auto q = i / 64;
+    const auto b = q / BLOCK_QUADS;
+
+    size_t res = supers_[q / SUPER_QUADS] + blocks_[b];
+    for (auto j = b * BLOCK_QUADS; j < q; ++j) {
+      res += pop_count<Popcnt>(data_[j]);
+    }
+    if (i % 64) {
+      res += pop_count<Popcnt>(data_[q] & ((0x1ull << (i % 64)) - 1));
+    }
+    return res;
+  }
+  /** Returns the number of set bits in x, using popcnt if Popcnt is true. */
+  template <bool Popcnt>
+  __attribute__((always_inline))
+  static inline size_t pop_count(uint64_t x) {
+    return Popcnt ? __builtin_popcountll(x) : BitManip<uint64_t>::pop_count_scalar(x);
+  }
+
+  /** Returns the i'th quad, ignoring any bits past the end of the bit string. */
+  uint64_t quad(size_t i) const {
+    if (num_bits_ % 64 && i == num_bits_ / 64) {
+      return data_[i] & ((0x1ull << (num_bits_ % 64)) - 1);
+    }
+    return data_[i];
+  }
+};
+
+} // namespace cpputil
+
+#endif
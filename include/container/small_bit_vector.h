@@ -0,0 +1,232 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_CONTAINER_SMALL_BIT_VECTOR_H
+#define CPPUTIL_INCLUDE_CONTAINER_SMALL_BIT_VECTOR_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "include/allocator/aligned.h"
+#include "include/bits/bulk_copy.h"
+#include "include/container/bit_string.h"
+
+namespace cpputil {
+
+/* Quads that live inside the object until there are more than N of them,
+ * and in a 32-byte aligned heap block after that. Provides just enough of the
+ * std::vector interface for BitString. Moving heap quads hands over the
+ * block; moving inline quads copies at most N of them.
+ *
+ * The inline quads are aligned at run time rather than with alignas, since
+ * neither new nor std::allocator honors over-aligned types in C++11. */
+template <size_t N>
+class SmallQuads {
+ public:
+  typedef uint64_t value_type;
+  typedef uint64_t* iterator;
+  typedef const uint64_t* const_iterator;
+
+  /** Creates an empty set of quads. */
+  SmallQuads() : data_(local()), size_(0), capacity_(N) { }
+  /** Copy constructor. */
+  SmallQuads(const SmallQuads& rhs) : SmallQuads() {
+    resize(rhs.size_);
+    std::copy(rhs.begin(), rhs.end(), data_);
+  }
+  /** Move constructor. */
+  SmallQuads(SmallQuads&& rhs) : SmallQuads() {
+    steal(rhs);
+  }
+  /** Assignment operator. */
+  SmallQuads& operator=(const SmallQuads& rhs) {
+    if (this != &rhs) {
+      resize(rhs.size_);
+      std::copy(rhs.begin(), rhs.end(), data_);
+    }
+    return *this;
+  }
+  /** Move assignment operator. */
+  SmallQuads& operator=(SmallQuads&& rhs) {
+    if (this != &rhs) {
+      release();
+      steal(rhs);
+    }
+    return *this;
+  }
+  /** Frees the heap block, if any. */
+  ~SmallQuads() {
+    release();
+  }
+
+  /** Returns the number of quads. */
+  size_t size() const {
+    return size_;
+  }
+  /** Returns true if the quads are stored inside this object. */
+  bool is_inline() const {
+    return data_ == local();
+  }
+  /** Changes the number of quads; new quads are zero. */
+  void resize(size_t n) {
+    if (n > capacity_) {
+      const auto cap = std::max(n, 2 * capacity_);
+      const auto p = Aligned<uint64_t, 32>().allocate(cap);
+      std::copy(data_, data_ + size_, p);
+      const auto size = size_;
+      release();
+      data_ = p;
+      size_ = size;
+      capacity_ = cap;
+    }
+    if (n > size_) {
+      std::fill(data_ + size_, data_ + n, 0);
+    }
+    size_ = n;
+  }
+
+  /** Returns the quads. */
+  uint64_t* data() {
+    return data_;
+  }
+  /** Returns the quads. */
+  const uint64_t* data() const {
+    return data_;
+  }
+
+  /** Returns a quad. */
+  uint64_t& operator[](size_t i) {
+    return data_[i];
+  }
+  /** Returns a quad. */
+  const uint64_t& operator[](size_t i) const {
+    return data_[i];
+  }
+
+  /** Quad iterator. */
+  iterator begin() {
+    return data_;
+  }
+  /** Quad iterator. */
+  iterator end() {
+    return data_ + size_;
+  }
+  /** Quad iterator. */
+  const_iterator begin() const {
+    return data_;
+  }
+  /** Quad iterator. */
+  const_iterator end() const {
+    return data_ + size_;
+  }
+
+ private:
+  uint64_t inline_[N + 3];
+  uint64_t* data_;
+  size_t size_;
+  size_t capacity_;
+
+  /** Returns the first 32-byte aligned quad of the inline storage. */
+  uint64_t* local() {
+    return (uint64_t*)(((uintptr_t) inline_ + 31) & ~(uintptr_t) 31);
+  }
+  /** Returns the first 32-byte aligned quad of the inline storage. */
+  const uint64_t* local() const {
+    return (const uint64_t*)(((uintptr_t) inline_ + 31) & ~(uintptr_t) 31);
+  }
+  /** Frees the heap block, if any, and goes back to inline storage. */
+  void release() {
+    if (!is_inline()) {
+      Aligned<uint64_t, 32>().deallocate(data_, capacity_);
+    }
+    data_ = local();
+    size_ = 0;
+    capacity_ = N;
+  }
+  /** Takes the quads of rhs, which is left empty; this must be empty. */
+  void steal(SmallQuads& rhs) {
+    if (rhs.is_inline()) {
+      std::copy(rhs.begin(), rhs.end(), data_);
+      size_ = rhs.size_;
+    } else {
+      data_ = rhs.data_;
+      size_ = rhs.size_;
+      capacity_ = rhs.capacity_;
+      rhs.data_ = rhs.local();
+      rhs.capacity_ = N;
+    }
+    rhs.size_ = 0;
+  }
+};
+
+/* A bit vector that keeps up to 64 * N bits inside the object, and only goes
+ * to the heap when it grows past that. Creating, copying and destroying small
+ * bit vectors costs no allocation and reading one costs no pointer chase. */
+template <size_t N = 4>
+class SmallBitVector : public BitString<SmallQuads<N>> {
+ public:
+  /** Creates an empty bit vector. */
+  SmallBitVector() : BitString<SmallQuads<N>>() { }
+  /** Creates a bit vector to hold n bits. */
+  SmallBitVector(size_t n) : BitString<SmallQuads<N>>() {
+    resize_for_bits(n);
+  }
+  /** Creates a bit vector from a bit-wise expression. */
+  template <typename E>
+  SmallBitVector(const BitExpr<E>& e) :
+    SmallBitVector(BitExprOperand<E>::get(e.derived()).num_bits()) {
+    *this = e;
+  }
+
+  using BitString<SmallQuads<N>>::operator=;
+
+  /** Returns true if the bits are stored inside this object. */
+  bool is_inline() const {
+    return this->contents_.is_inline();
+  }
+
+  /** Resizes a SmallBitVector to contain n bits. */
+  void resize_for_bits(size_t n) {
+    this->contents_.resize((n + 63) / 64);
+    this->num_bits_ = n;
+  }
+
+  /** Set all elements to zero. */
+  void reset(StoreMode mode = StoreMode::AUTO) {
+    BulkCopy::fill(this->contents_.data(), this->contents_.size(), 0, mode);
+  }
+  /** Set all elements to one. */
+  void set(StoreMode mode = StoreMode::AUTO) {
+    BulkCopy::fill(this->contents_.data(), this->contents_.size(), -1, mode);
+    this->mask_tail();
+  }
+};
+
+} // namespace cpputil
+
+namespace std {
+
+/** STL-compliant hash. */
+template <size_t N>
+struct hash<cpputil::SmallBitVector<N>> {
+  size_t operator()(const cpputil::SmallBitVector<N>& bs) const {
+    return bs.hash();
+  }
+};
+
+} // namespace std
+
+#endif
@@ -0,0 +1,176 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_MEMORY_CONCURRENT_INTERNER_H
+#define CPPUTIL_INCLUDE_MEMORY_CONCURRENT_INTERNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cpputil {
+
+/* An Interner that many threads can use at once. Values are spread over
+ * Shards shards by the high bits of their hash. Each shard keeps its values
+ * in a deque, which never moves them, and indexes them with an open-addressed
+ * table of pointers that only ever gains entries. A value that is already
+ * interned is found without locks or writes to shared memory; a value that
+ * isn't takes the shard's lock, and is added to the table after it has been
+ * built, so a concurrent reader sees either nothing or the whole value. When
+ * a table fills up, a table twice the size replaces it, and the old one is
+ * kept until the interner is destroyed, since readers may still be using it.
+ * References stay valid for the lifetime of the interner. */
+template <typename T, typename Hash = std::hash<T>, typename Eq = std::equal_to<T>,
+          size_t Shards = 64>
+class ConcurrentInterner {
+ public:
+  static_assert(Shards > 0 && Shards <= (1 << 16) && (Shards & (Shards - 1)) == 0,
+                "Shards must be a power of two of at most 2^16");
+
+  typedef T value_type;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+
+  /** Creates an empty interner. */
+  ConcurrentInterner() : shards_(new Shard[Shards]) { }
+
+  ConcurrentInterner(const ConcurrentInterner&) = delete;
+  ConcurrentInterner& operator=(const ConcurrentInterner&) = delete;
+
+  /** Returns the interned copy of t. */
+  const_reference intern(const_reference t) {
+    const auto h = mix(Hash()(t));
+    auto& s = shards_[(h >> 48) & (Shards - 1)];
+    if (const auto n = find(s.table.load(std::memory_order_acquire), t, h)) {
+      return n->value;
+    }
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto tb = s.table.load(std::memory_order_relaxed);
+    if (const auto n = find(tb, t, h)) {
+      return n->value;
+    }
+    if (tb == nullptr || 2 * (s.size.load(std::memory_order_relaxed) + 1) > tb->mask + 1) {
+      tb = grow(s);
+    }
+    s.nodes.emplace_back(h, t);
+    insert(tb, &s.nodes.back());
+    s.size.store(s.size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return s.nodes.back().value;
+  }
+
+  /** Returns true if nothing has been interned. */
+  bool empty() const {
+    return size() == 0;
+  }
+  /** Returns the number of interned values. This is exact only when no
+   * other thread is interning. */
+  size_type size() const {
+    size_t res = 0;
+    for (size_t i = 0; i < Shards; ++i) {
+      res += shards_[i].size.load(std::memory_order_relaxed);
+    }
+    return res;
+  }
+
+ private:
+  enum : size_t {
+    MIN_SLOTS = 16
+  };
+
+  /** An interned value, with its hash. */
+  struct Node {
+    uint64_t hash;
+    T value;
+
+    Node(uint64_t h, const_reference t) : hash(h), value(t) { }
+  };
+  /** A power of two number of slots, probed linearly. */
+  struct Table {
+    size_t mask;
+    std::unique_ptr<std::atomic<const Node*>[]> slots;
+
+    explicit Table(size_t n) : mask(n - 1), slots(new std::atomic<const Node*>[n]()) { }
+  };
+  /** A shard; padded so that neighbouring shards' locks and tables don't
+   * share a cache line. */
+  struct Shard {
+    std::atomic<Table*> table;
+    std::atomic<size_t> size;
+    std::mutex mutex;
+    std::deque<Node> nodes;
+    std::vector<std::unique_ptr<Table>> tables;
+    char pad[64];
+
+    Shard() : table(nullptr), size(0) { }
+  };
+
+  std::unique_ptr<Shard[]> shards_;
+
+  /** Spreads the bits of a hash, which std::hash leaves as is for integers,
+   * so that the high bits pick shards and the low bits pick slots. This is
+   * the final mix of MurmurHash3. */
+  static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  /** Returns the node for t in tb, or nullptr. */
+  static const Node* find(const Table* tb, const_reference t, uint64_t h) {
+    if (tb == nullptr) {
+      return nullptr;
+    }
+    for (auto i = h & tb->mask; ; i = (i + 1) & tb->mask) {
+      const auto n = tb->slots[i].load(std::memory_order_acquire);
+      if (n == nullptr) {
+        return nullptr;
+      } else if (n->hash == h && Eq()(n->value, t)) {
+        return n;
+      }
+    }
+  }
+  /** Adds a node to the first free slot in its probe sequence. */
+  static void insert(Table* tb, const Node* n) {
+    auto i = n->hash & tb->mask;
+    while (tb->slots[i].load(std::memory_order_relaxed) != nullptr) {
+      i = (i + 1) & tb->mask;
+    }
+    tb->slots[i].store(n, std::memory_order_release);
+  }
+  /** Replaces a shard's table with one twice the size, and returns it. */
+  static Table* grow(Shard& s) {
+    const auto old = s.table.load(std::memory_order_relaxed);
+    s.tables.emplace_back(new Table(old == nullptr ? MIN_SLOTS : 2 * (old->mask + 1)));
+    const auto tb = s.tables.back().get();
+    for (const auto& n : s.nodes) {
+      insert(tb, &n);
+    }
+    s.table.store(tb, std::memory_order_release);
+    return tb;
+  }
+};
+
+} // namespace cpputil
+
+#endif
@@ -0,0 +1,102 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_SYSTEM_CPU_FEATURES_H
+#define CPPUTIL_INCLUDE_SYSTEM_CPU_FEATURES_H
+
+#include <cstdlib>
+#include <cstring>
+
+namespace cpputil {
+
+/** The instruction sets that dispatched kernels are written for. Each level
+ * includes the ones before it. */
+enum class SimdLevel : int {
+  /** SSE2, which every x86-64 host has. */
+  SSE2,
+  /** AVX2 along with BMI1, BMI2 and POPCNT; Haswell and later. */
+  AVX2,
+  /** AVX-512 F, BW and VL on top of AVX2; Skylake-X and later. */
+  AVX512
+};
+
+/* The instruction sets of the host. Kernels that exist in several versions
+ * ask this class which one to use, once, and keep the answer; the compiler
+ * flags a program was built with don't matter. Setting CPPUTIL_SIMD to sse2,
+ * avx2 or avx512 caps the level, which is how the slower kernels can be
+ * tried out on a fast host. */
+class CpuFeatures {
+ public:
+  /** Returns the best level the host supports, capped by CPPUTIL_SIMD. */
+  static SimdLevel level() {
+    static const SimdLevel l = cap(detect());
+    return l;
+  }
+
+  /** True if kernels may use AVX2, BMI1, BMI2 and POPCNT. */
+  static bool has_avx2() {
+    return level() >= SimdLevel::AVX2;
+  }
+  /** True if kernels may use AVX-512 F, BW and VL. */
+  static bool has_avx512() {
+    return level() >= SimdLevel::AVX512;
+  }
+  /** True if kernels may use POPCNT. Some hosts below AVX2 have it too;
+   * CPPUTIL_SIMD=sse2 turns it off along with everything else. */
+  static bool has_popcnt() {
+    static const bool b = has_avx2() || (cap(SimdLevel::AVX2) != SimdLevel::SSE2 &&
+                                         __builtin_cpu_supports("popcnt"));
+    return b;
+  }
+
+  /** Returns the name of a level, as it is spelled in CPPUTIL_SIMD. */
+  static const char* name(SimdLevel l) {
+    switch (l) {
+    case SimdLevel::AVX512:
+      return "avx512";
+    case SimdLevel::AVX2:
+      return "avx2";
+    default:
+      return "sse2";
+    }
+  }
+
+ private:
+  /** Returns the best level the host supports. */
+  static SimdLevel detect() {
+    __builtin_cpu_init();
+    const auto avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") &&
+                      __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt");
+    const auto avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                        __builtin_cpu_supports("avx512vl");
+    return avx2 && avx512 ? SimdLevel::AVX512 : avx2 ? SimdLevel::AVX2 : SimdLevel::SSE2;
+  }
+
+  /** Lowers a level to the one named by CPPUTIL_SIMD, if that is lower. */
+  static SimdLevel cap(SimdLevel l) {
+    const auto env = getenv("CPPUTIL_SIMD");
+    if (env == nullptr) {
+      return l;
+    } else if (strcmp(env, name(SimdLevel::SSE2)) == 0) {
+      return SimdLevel::SSE2;
+    } else if (strcmp(env, name(SimdLevel::AVX2)) == 0 && l > SimdLevel::AVX2) {
+      return SimdLevel::AVX2;
+    }
+    return l;
+  }
+};
+
+} // namespace cpputil
+
+#endif
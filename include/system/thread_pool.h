@@ -0,0 +1,153 @@
+// Copyright 2014 eric schkufza
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CPPUTIL_INCLUDE_SYSTEM_THREAD_POOL_H
+#define CPPUTIL_INCLUDE_SYSTEM_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cpputil {
+
+/* A fixed set of worker threads for fork-join loops. run() hands out the
+ * iterations of a loop to the workers and to the calling thread, and returns
+ * once they have all finished. Calls to run() from different threads are
+ * serialized; calling run() from inside a loop body deadlocks, as does a loop
+ * body that throws. */
+class ThreadPool {
+ public:
+  /** Creates a pool that runs loops on n threads, counting the caller. */
+  explicit ThreadPool(size_t n = std::thread::hardware_concurrency()) :
+    num_tasks_(0), next_(0), generation_(0), active_(0), open_(false), stop_(false) {
+    for (size_t i = 1; i < n; ++i) {
+      workers_.emplace_back([this] {
+        work_loop();
+      });
+    }
+  }
+  ThreadPool(const ThreadPool& rhs) = delete;
+  ThreadPool& operator=(const ThreadPool& rhs) = delete;
+
+  /** Stops and joins the workers. */
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& w : workers_) {
+      w.join();
+    }
+  }
+
+  /** Returns the number of threads that run() uses, counting the caller. */
+  size_t num_threads() const {
+    return workers_.size() + 1;
+  }
+
+  /** Calls f(i) for every i in [0, n), and returns once every call has. */
+  template <typename F>
+  void run(size_t n, F f) {
+    if (workers_.empty() || n <= 1) {
+      for (size_t i = 0; i < n; ++i) {
+        f(i);
+      }
+      return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = f;
+      num_tasks_ = n;
+      next_ = 0;
+      ++generation_;
+      open_ = true;
+    }
+    start_.notify_all();
+
+    work();
+
+    // Every iteration has been claimed; wait for the workers that claimed
+    // some to finish them, and keep latecomers from joining in
+    std::unique_lock<std::mutex> lock(mutex_);
+    open_ = false;
+    done_.wait(lock, [this] {
+      return active_ == 0;
+    });
+  }
+
+ private:
+  std::vector<std::thread> workers_;
+
+  /* The current loop. These only change while no worker is active. */
+  std::function<void(size_t)> job_;
+  size_t num_tasks_;
+  std::atomic<size_t> next_;
+
+  /* Guards everything below, and wakes workers when a loop is started */
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  size_t generation_;
+  size_t active_;
+  bool open_;
+  bool stop_;
+
+  /* Serializes calls to run() */
+  std::mutex run_mutex_;
+
+  /** Claims and runs iterations of the current loop until there are none left. */
+  void work() {
+    for (size_t i; (i = next_.fetch_add(1)) < num_tasks_; ) {
+      job_(i);
+    }
+  }
+
+  /** The body of a worker thread. */
+  void work_loop() {
+    size_t seen = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [this, seen] {
+          return stop_ || generation_ != seen;
+        });
+        if (stop_) {
+          return;
+        }
+        seen = generation_;
+        if (!open_) {
+          continue;
+        }
+        ++active_;
+      }
+
+      work();
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--active_ == 0) {
+        done_.notify_all();
+      }
+    }
+  }
+};
+
+} // namespace cpputil
+
+#endif